@@ -3,203 +3,996 @@
 
 #include <iostream>
 #include <string>
+#include <string_view>
 #include <set>
+#include <vector>
 #include <algorithm>
+#include <iterator>
+#include <cstddef>
 #include <fstream>
-#include <ncurses.h>
+#include <sstream>
+#include <climits>
+#include <cstdio>
+#include <optional>
+#include <stdexcept>
+#include <type_traits>
+#include "EventStore.h"
+#include "Export.h"
+#include "NodePool.h"
+#include "ThreadPool.h"
 
 using namespace std;
 
-class Event {
-public:
+// What the tree orders by, plus the store slot holding the rest of the
+// event. Ordered exactly like Event.
+struct EventKey {
+    int start;
+    int end;
     int id;
-    string name;
-    string date;
-    string startTime;
-    string endTime;
-    set<int> dependencies;
+    int slot;
 
-    Event(int id = 0, string name = "", string date = "", string startTime = "", string endTime = "")
-        : id(id), name(name), date(date), startTime(startTime), endTime(endTime) {}
+    EventKey(int start, int end, int id, int slot) : start(start), end(end), id(id), slot(slot) {}
 
-    bool operator<(const Event& other) const {
-        if (date != other.date) return date < other.date;
-        if (startTime != other.startTime) return startTime < other.startTime;
-        return endTime < other.endTime;
-    }
+    EventKey(const Event& event, int slot) : start(event.start), end(event.end), id(event.id), slot(slot) {}
 
-    bool operator>(const Event& other) const {
-        return other < *this;
-    }
+    EventKey(const EventStore& store, int slot)
+        : start(store.start(slot)), end(store.end(slot)), id(store.id(slot)), slot(slot) {}
 
-    bool operator==(const Event& other) const {
-        return id == other.id;
+    bool operator<(const EventKey& other) const {
+        if (start != other.start) return start < other.start;
+        if (end != other.end) return end < other.end;
+        return id < other.id;
     }
 
-    bool operator!=(const Event& other) const {
-        return !(*this == other);
+    bool operator>(const EventKey& other) const {
+        return other < *this;
     }
-
-    friend ostream& operator<<(ostream& os, const Event& event);
-    friend istream& operator>>(istream& is, Event& event);
 };
 
-ostream& operator<<(ostream& os, const Event& event) {
-    os << event.id << "," << event.name << "," << event.date << "," << event.startTime << "," << event.endTime;
-        for (int dep : event.dependencies) {
-            os << "," << dep;
-        }
-        return os;
-}
-
-istream& operator>>(istream& is, Event& event) {
-    string line;
-        if (getline(is, line)) {
-            stringstream ss(line);
-            string token;
-            getline(ss, token, ',');
-            event.id = stoi(token);
-            getline(ss, event.name, ',');
-            getline(ss, event.date, ',');
-            getline(ss, event.startTime, ',');
-            getline(ss, event.endTime, ',');
-
-            while (getline(ss, token, ',')) {
-                event.dependencies.insert(stoi(token));
-            }
-        }
-        return is;
-}
-
 struct AVLNode {
-    Event event;
+    EventKey key;
     AVLNode* left;
     AVLNode* right;
+    AVLNode* parent; // Kept by AVLTree::update, for iteration
     int height;
+    int maxEnd; // Latest end in this subtree, used to prune overlap queries
+    int size;   // Nodes in this subtree, for rank and select
+    int minStart; // Earliest start in this subtree
+    int maxGap;   // At least the widest gap between events in this subtree, see update
 
-    AVLNode(const Event& event, AVLNode* lt, AVLNode* rt, int h = 0)
-        : event(event), left(lt), right(rt), height(h) {}
+    AVLNode(const EventKey& key, AVLNode* lt, AVLNode* rt, int h = 0)
+        : key(key), left(lt), right(rt), parent(nullptr), height(h), maxEnd(key.end), size(1), minStart(key.start),
+          maxGap(0) {}
 };
 
 class AVLTree {
 public:
-    AVLTree() : root(nullptr) {}
+    // In-order (time-ordered) bidirectional iterator over the stored events.
+    // Events are kept column-wise in the store, so dereferencing builds one;
+    // key() reads just the times and id without doing so.
+    class const_iterator {
+    public:
+        // Lets it->name work on the Event built by operator->
+        struct ArrowProxy {
+            Event event;
+            const Event* operator->() const {
+                return &event;
+            }
+        };
+
+        using iterator_category = bidirectional_iterator_tag;
+        using value_type = Event;
+        using difference_type = ptrdiff_t;
+        using pointer = ArrowProxy;
+        using reference = Event;
+
+        const_iterator() : node(nullptr), tree(nullptr) {}
+
+        Event operator*() const {
+            return tree->store->event(node->key.slot);
+        }
+
+        ArrowProxy operator->() const {
+            return {**this};
+        }
+
+        const EventKey& key() const {
+            return node->key;
+        }
+
+        // Whether the event has a repeat rule, also without building it
+        bool repeats() const {
+            return tree->store->repeats(node->key.slot);
+        }
+
+        const_iterator& operator++() {
+            if (node->right != nullptr) {
+                node = node->right;
+                while (node->left != nullptr) node = node->left;
+            } else {
+                const AVLNode* child = node;
+                node = node->parent;
+                while (node != nullptr && child == node->right) {
+                    child = node;
+                    node = node->parent;
+                }
+            }
+            return *this;
+        }
+
+        // Decrementing end() yields the last event
+        const_iterator& operator--() {
+            if (node == nullptr) {
+                node = tree->root;
+                while (node != nullptr && node->right != nullptr) node = node->right;
+            } else if (node->left != nullptr) {
+                node = node->left;
+                while (node->right != nullptr) node = node->right;
+            } else {
+                const AVLNode* child = node;
+                node = node->parent;
+                while (node != nullptr && child == node->left) {
+                    child = node;
+                    node = node->parent;
+                }
+            }
+            return *this;
+        }
+
+        const_iterator operator++(int) {
+            const_iterator old = *this;
+            ++*this;
+            return old;
+        }
+
+        const_iterator operator--(int) {
+            const_iterator old = *this;
+            --*this;
+            return old;
+        }
+
+        bool operator==(const const_iterator& other) const {
+            return node == other.node;
+        }
+
+        bool operator!=(const const_iterator& other) const {
+            return node != other.node;
+        }
+
+    private:
+        friend class AVLTree;
+        const AVLNode* node;
+        const AVLTree* tree;
+
+        const_iterator(const AVLNode* node, const AVLTree* tree) : node(node), tree(tree) {}
+    };
+
+    // A lazily walked [first, last) slice of the tree, usable in range-for
+    struct Range {
+        const_iterator first;
+        const_iterator last;
+
+        const_iterator begin() const {
+            return first;
+        }
+
+        const_iterator end() const {
+            return last;
+        }
+    };
+
+    // A tree that keeps its events in a store of its own
+    AVLTree() : store(&ownStore), root(nullptr) {}
+
+    // A tree over a store shared with other indexes. insert() still adds or
+    // refreshes the event in the store, but remove() only unfiles it:
+    // whoever owns the store drops the event itself.
+    explicit AVLTree(EventStore& shared) : store(&shared), root(nullptr) {}
 
     ~AVLTree() {
         makeEmpty(root);
     }
 
+    // An event whose id is already stored replaces it, so updating an
+    // event's time is a single insert
     void insert(const Event& event) {
-        insert(event, root);
+        file(store->add(event));
     }
 
+    // Re-files an event already in the store under its current time, with
+    // no copy; call after adding it to a shared store or changing its times
+    void reindex(int id) {
+        int slot = store->slotOf(id);
+        if (slot != -1) {
+            file(slot);
+        }
+    }
+
+    // Finds the node through the id index, then removes it by its time key:
+    // O(log n) regardless of how ids relate to times
     void remove(int id) {
-        remove(id, root);
+        AVLNode* node = nodeOf(id);
+        if (node != nullptr) {
+            unfile(node->key);
+        }
+        if (ownsStore()) {
+            store->remove(id);
+        }
     }
 
-    bool detectConflicts(const Event& event) const {
-        return detectConflicts(event, root);
+    // Removes the node holding this event, descending by its time key
+    void remove(const Event& event) {
+        if (unfile(EventKey(event, -1)) && ownsStore()) {
+            store->remove(event.id);
+        }
+    }
+
+    optional<Event> find(int id) const {
+        AVLNode* node = nodeOf(id);
+        if (node == nullptr) {
+            return nullopt;
+        }
+        return store->event(node->key.slot);
     }
 
-    void visualize() const {
+    // Replaces the contents with events already sorted by operator<, in O(n)
+    void buildFromSorted(const vector<Event>& sorted) {
         clear();
-        ofstream outfile("avltree.dot");
-        if (!outfile) {
-            cerr << "Error creating dot file" << endl;
+        vector<EventKey> keys;
+        keys.reserve(sorted.size());
+        for (const Event& event : sorted) {
+            keys.emplace_back(event, store->add(event));
+        }
+        build(keys);
+    }
+
+    // Files every event in the store, replacing the current contents; O(n)
+    // if the store is already in time order
+    void buildFromStore() {
+        makeEmpty(root);
+        nodeOfId.clear();
+        vector<EventKey> keys;
+        keys.reserve(store->size());
+        for (size_t slot = 0; slot < store->slots(); ++slot) {
+            if (store->isLive(slot)) {
+                keys.emplace_back(*store, slot);
+            }
+        }
+        if (!is_sorted(keys.begin(), keys.end())) {
+            sort(keys.begin(), keys.end());
+        }
+        build(keys);
+    }
+
+    void clear() {
+        makeEmpty(root);
+        nodeOfId.clear();
+        if (ownsStore()) {
+            store->clear();
+        }
+    }
+
+    // Adds every event of other: join-based union, O(m log(n/m + 1)) for
+    // the smaller side m, after copying other's events into nodes of this
+    // tree. Given workers, the work is spread across them. Where both hold
+    // an id, other's version wins. A tree over a shared store only merges
+    // trees over that same store; it cannot add events behind the owner's
+    // back.
+    void unionWith(const AVLTree& other, ThreadPool* workers = nullptr) {
+        if (&other == this) {
             return;
         }
-        outfile << "digraph AVLTree {\n";
-        if (root) {
-            visualize(outfile, root);
+        vector<AVLNode*> theirs;
+        collect(other.root, theirs);
+        AVLNode* copies = adopt(theirs, *other.store);
+        vector<AVLNode*> dropped;
+        root = setOperation(root, copies, true, workers, dropped);
+        if (root) root->parent = nullptr;
+        discard(dropped);
+    }
+
+    // Removes every event other holds with the same id and times, in the
+    // same join-based way; other is only read
+    void differenceWith(const AVLTree& other, ThreadPool* workers = nullptr) {
+        if (&other == this) {
+            clear();
+            return;
+        }
+        vector<AVLNode*> dropped;
+        root = setOperation(root, other.root, false, workers, dropped);
+        if (root) root->parent = nullptr;
+        discard(dropped);
+    }
+
+    // Moves the events starting at or after time into later, which must be
+    // empty. The split is O(log n); handing the k moved events over costs
+    // O(k), since every tree allocates its own nodes.
+    void splitAt(int time, AVLTree& later) {
+        if (&later == this || later.root != nullptr) {
+            throw runtime_error("splitAt needs a separate, empty tree");
+        }
+        if (!later.usesStore(*store) && !later.ownsStore()) {
+            throw runtime_error("A tree over a shared store only takes events from trees over the same store");
+        }
+        AVLNode* moved;
+        split(root, EventKey(time, INT_MIN, INT_MIN, -1), root, moved);
+        if (root) root->parent = nullptr;
+        vector<AVLNode*> nodes;
+        collect(moved, nodes);
+        later.root = later.adopt(nodes, *store);
+        if (later.root) later.root->parent = nullptr;
+        discard(nodes);
+    }
+
+    // Appends every event of later, all of which must sort after this
+    // tree's last, and empties later: O(m) to copy them over, then a single
+    // O(log n) join
+    void join(AVLTree& later) {
+        if (&later == this) {
+            throw runtime_error("Cannot join a tree to itself");
+        }
+        AVLNode* last = findMax(root);
+        AVLNode* first = findMin(later.root);
+        if (last != nullptr && first != nullptr && !(last->key < first->key)) {
+            throw runtime_error("join needs every event of the other tree to sort after this tree's");
+        }
+        vector<AVLNode*> theirs;
+        collect(later.root, theirs);
+        root = join2(root, adopt(theirs, *later.store));
+        if (root) root->parent = nullptr;
+        later.clear();
+    }
+
+    size_t size() const {
+        return size(root);
+    }
+
+    // Number of stored events ordered before event (by time, then id);
+    // O(log n), and event need not be stored
+    size_t rank(const Event& event) const {
+        EventKey key(event, -1);
+        size_t count = 0;
+        for (const AVLNode* t = root; t != nullptr;) {
+            if (t->key < key) {
+                count += size(t->left) + 1;
+                t = t->right;
+            } else {
+                t = t->left;
+            }
+        }
+        return count;
+    }
+
+    // The k-th event in time order, counting from 0; end() past the last.
+    // O(log n), so a page of a long schedule starts at select(page * size).
+    const_iterator select(size_t k) const {
+        const AVLNode* t = root;
+        while (t != nullptr) {
+            size_t before = size(t->left);
+            if (k < before) {
+                t = t->left;
+            } else if (k == before) {
+                break;
+            } else {
+                k -= before + 1;
+                t = t->right;
+            }
+        }
+        return const_iterator(t, this);
+    }
+
+    // Events starting in [from, to), minutes since epoch; O(log n)
+    size_t countInRange(int from, int to) const {
+        if (from >= to) {
+            return 0;
+        }
+        return countBefore(to) - countBefore(from);
+    }
+
+    // Start of the earliest free window of duration minutes at or after
+    // from: one detectConflicts would accept. Subtrees whose gaps are all
+    // too narrow are skipped whole, so this is O(log n) unless long events
+    // overlap many later gaps, which makes the cached widths too generous
+    // and sends the search into more subtrees. The tree only holds the
+    // first occurrence of a repeating event, so a window one of the later
+    // ones falls into is retried after it.
+    int findFreeSlot(int from, int duration) const {
+        if (duration <= 0) {
+            throw runtime_error("Duration must be positive");
+        }
+        long long horizon = store->recurrences().empty() ? LLONG_MAX : repeatHorizon(from);
+        while (true) {
+            int reach = INT_MIN;
+            int slot;
+            if (!findFreeSlot(root, from, duration, reach, slot)) {
+                slot = max(reach, from);
+            }
+            if ((long long)slot + duration > INT_MAX) {
+                throw runtime_error("No free slot");
+            }
+            int busyUntil = repeatBusyUntil(slot, slot + duration);
+            if (busyUntil == INT_MIN) {
+                return slot;
+            }
+            if (busyUntil > horizon) {
+                throw runtime_error("No free slot");
+            }
+            from = busyUntil;
+        }
+    }
+
+    // findFreeSlot for each (from, duration) pair, in order. The tree is
+    // only read, so given workers the queries are split among them.
+    vector<int> findFreeSlots(const vector<pair<int, int>>& queries, ThreadPool* workers = nullptr) const {
+        vector<int> slots(queries.size());
+        if (workers == nullptr || queries.size() < FREE_SLOT_CHUNK) {
+            for (size_t i = 0; i < queries.size(); ++i) {
+                slots[i] = findFreeSlot(queries[i].first, queries[i].second);
+            }
+            return slots;
+        }
+        size_t chunks = (queries.size() + FREE_SLOT_CHUNK - 1) / FREE_SLOT_CHUNK;
+        workers->parallelFor(chunks, [&](size_t c) {
+            size_t last = min(queries.size(), (c + 1) * FREE_SLOT_CHUNK);
+            for (size_t i = c * FREE_SLOT_CHUNK; i < last; ++i) {
+                slots[i] = findFreeSlot(queries[i].first, queries[i].second);
+            }
+        });
+        return slots;
+    }
+
+    bool usesStore(const EventStore& other) const {
+        return store == &other;
+    }
+
+    const_iterator begin() const {
+        const AVLNode* t = root;
+        while (t != nullptr && t->left != nullptr) t = t->left;
+        return const_iterator(t, this);
+    }
+
+    const_iterator end() const {
+        return const_iterator(nullptr, this);
+    }
+
+    // First event starting at or after time (minutes since epoch)
+    const_iterator lowerBound(int time) const {
+        const AVLNode* result = nullptr;
+        for (const AVLNode* t = root; t != nullptr;) {
+            if (t->key.start >= time) {
+                result = t;
+                t = t->left;
+            } else {
+                t = t->right;
+            }
+        }
+        return const_iterator(result, this);
+    }
+
+    // First event starting strictly after time
+    const_iterator upperBound(int time) const {
+        const AVLNode* result = nullptr;
+        for (const AVLNode* t = root; t != nullptr;) {
+            if (t->key.start > time) {
+                result = t;
+                t = t->left;
+            } else {
+                t = t->right;
+            }
+        }
+        return const_iterator(result, this);
+    }
+
+    // Events starting in [from, to), produced one at a time as iterated
+    Range range(int from, int to) const {
+        if (from >= to) {
+            return Range{end(), end()};
+        }
+        return Range{lowerBound(from), lowerBound(to)};
+    }
+
+    // Whether any occurrence of event overlaps any occurrence of a stored
+    // event. A repeating event is filed once, under its first occurrence;
+    // its later ones are worked out against the query, never stored. A
+    // repeating query is checked against every filed event up to its last
+    // occurrence, so an endless rule costs a walk of everything after it.
+    bool detectConflicts(const Event& event) const {
+        if (detectConflicts(event, event.lastEnd(), root)) {
+            return true;
+        }
+        for (const auto& rule : store->recurrences()) {
+            Event other = store->times(rule.first);
+            if (other.id != event.id && other.overlaps(event)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // All stored events overlapping the given one, in time order. Against
+    // a one-off event a repeating event shows up as each occurrence that
+    // overlaps it, against a repeating one as itself.
+    vector<Event> findConflicts(const Event& event) const {
+        vector<Event> conflicts;
+        findConflicts(event, event.lastEnd(), root, conflicts);
+        size_t filed = conflicts.size();
+        for (const auto& rule : store->recurrences()) {
+            Event other = store->times(rule.first);
+            if (other.id == event.id) {
+                continue;
+            }
+            if (event.repeats()) {
+                if (other.overlaps(event)) {
+                    conflicts.push_back(store->event(rule.first));
+                }
+                continue;
+            }
+            long long k = other.occurrenceDuring(event.start, event.end);
+            if (k == -1) {
+                continue;
+            }
+            Event named = store->event(rule.first);
+            for (long long count = other.occurrences(); k < count; ++k) {
+                Event occurrence = named.occurrence(k);
+                if (occurrence.start >= event.end) break;
+                conflicts.push_back(move(occurrence));
+            }
+        }
+        sort(conflicts.begin() + filed, conflicts.end());
+        inplace_merge(conflicts.begin(), conflicts.begin() + filed, conflicts.end());
+        return conflicts;
+    }
+
+    // Occurrences after the first of every repeating event, starting in
+    // [from, to), in time order. The first is filed like a one-off event
+    // and comes from range(); only the asked-for window is expanded.
+    vector<Event> repeatsBetween(int from, int to) const {
+        vector<Event> found;
+        for (const auto& rule : store->recurrences()) {
+            Event series = store->times(rule.first);
+            long long period = series.recurrence.period();
+            long long k = max<long long>(1, ((long long)from - series.start + period - 1) / period);
+            long long count = series.occurrences();
+            if (k >= count || series.start + k * period >= to) {
+                continue;
+            }
+            series.name = store->name(rule.first);
+            for (; k < count && series.start + k * period < to; ++k) {
+                found.push_back(series.occurrence(k));
+            }
         }
-        outfile << "}\n";
-        outfile.close();
-        system("dot -Tpng avltree.dot -o avltree.png");
-        system("xdg-open avltree.png");
-        mvprintw(2, 0, "Event graph exported and visualized");
-        mvprintw(4, 0, "Press any key to return to the main menu...");
-        refresh();
-        getch();
+        sort(found.begin(), found.end());
+        return found;
+    }
+
+    // Streams the tree shape, cut down to the nodes starting in scope's
+    // date range, and returns the number written. Each such node hangs
+    // under its nearest ancestor in range, so the cut is still a binary
+    // search tree. JSON nests {"id", "name", "left", "right"} objects the
+    // way visualize_avl_tree.py reads them; CSV rows are
+    // id,name,date,start,end,left id,right id.
+    size_t exportTo(ExportWriter& out, ExportFormat format, const ExportScope& scope = ExportScope()) const {
+        size_t written = 0;
+        AVLNode* top = topmostIn(root, scope);
+        switch (format) {
+        case ExportFormat::Dot:
+            out << "digraph AVLTree {\n";
+            exportDot(out, top, scope, written);
+            out << "}\n";
+            break;
+        case ExportFormat::Json:
+            exportJson(out, top, scope, written);
+            out << '\n';
+            break;
+        case ExportFormat::Csv:
+            exportCsv(out, top, scope, written);
+            break;
+        }
+        return written;
+    }
+
+    // Walks the whole tree checking balance, order, parent links, the id
+    // index and every cached field against its children. O(n); for tests.
+    // Throws naming the first broken invariant.
+    void verify() const {
+        const AVLNode* previous = nullptr;
+        verify(root, nullptr, previous);
     }
 
 private:
+    EventStore ownStore;
+    EventStore* store; // &ownStore unless shared
     AVLNode* root;
+    vector<AVLNode*> nodeOfId; // Event id -> node holding it, nullptr when absent
+#ifndef AVLTREE_NO_POOL
+    NodePool<AVLNode> pool;
+#endif
 
-    void insert(const Event& event, AVLNode*& t) {
+    bool ownsStore() const {
+        return store == &ownStore;
+    }
+
+    // Files the event in slot, unfiling any older version of it first
+    void file(int slot) {
+        AVLNode* node = nodeOf(store->id(slot));
+        if (node != nullptr) {
+            unfile(node->key);
+        }
+        insert(EventKey(*store, slot), root);
+        if (root) root->parent = nullptr;
+    }
+
+    // Removes the node with this key from the tree only; true if found.
+    // Takes a copy, since the key usually lives in the node being removed.
+    bool unfile(EventKey key) {
+        bool found = remove(key, root);
+        if (root) root->parent = nullptr;
+        return found;
+    }
+
+    void build(const vector<EventKey>& keys) {
+        root = buildFromSorted(keys, 0, keys.size());
+        if (root) root->parent = nullptr;
+    }
+
+    void insert(const EventKey& key, AVLNode*& t) {
         if (t == nullptr) {
-            t = new AVLNode(event, nullptr, nullptr);
-        } else if (event < t->event) {
-            insert(event, t->left);
+            t = newNode(key, nullptr, nullptr);
+            index(t);
+        } else if (key < t->key) {
+            insert(key, t->left);
             if (height(t->left) - height(t->right) == 2) {
-                if (event < t->left->event) {
+                if (key < t->left->key) {
                     rotateWithLeftChild(t);
                 } else {
                     doubleWithLeftChild(t);
                 }
             }
-        } else if (event > t->event) {
-            insert(event, t->right);
+        } else if (key > t->key) {
+            insert(key, t->right);
             if (height(t->right) - height(t->left) == 2) {
-                if (event > t->right->event) {
+                if (key > t->right->key) {
                     rotateWithRightChild(t);
                 } else {
                     doubleWithRightChild(t);
                 }
             }
         }
-        t->height = max(height(t->left), height(t->right)) + 1;
+        update(t);
+    }
+
+    // Midpoint splits keep sibling sizes within one, so the result is balanced
+    AVLNode* buildFromSorted(const vector<EventKey>& sorted, size_t lo, size_t hi) {
+        if (lo >= hi) {
+            return nullptr;
+        }
+        size_t mid = lo + (hi - lo) / 2;
+        AVLNode* left = buildFromSorted(sorted, lo, mid);
+        AVLNode* right = buildFromSorted(sorted, mid + 1, hi);
+        AVLNode* t = newNode(sorted[mid], left, right);
+        // An id already filed keeps its node; see adopt()
+        if (nodeOf(t->key.id) == nullptr) {
+            index(t);
+        }
+        update(t);
+        return t;
     }
 
-    void remove(int id, AVLNode*& t) {
+    bool remove(const EventKey& key, AVLNode*& t) {
         if (t == nullptr) {
-            return;
+            return false;
         }
-        if (id < t->event.id) {
-            remove(id, t->left);
-        } else if (id > t->event.id) {
-            remove(id, t->right);
+        bool found = true;
+        if (key < t->key) {
+            found = remove(key, t->left);
+        } else if (t->key < key) {
+            found = remove(key, t->right);
         } else if (t->left != nullptr && t->right != nullptr) {
-            t->event = findMin(t->right)->event;
-            remove(t->event.id, t->right);
+            // The successor's key moves up into this node, and its index
+            // entry with it; the successor's old node is then dropped
+            int oldId = t->key.id;
+            if (nodeOf(oldId) == t) {
+                nodeOfId[oldId] = nullptr;
+            }
+            t->key = findMin(t->right)->key;
+            index(t);
+            remove(t->key, t->right);
         } else {
             AVLNode* oldNode = t;
             t = (t->left != nullptr) ? t->left : t->right;
-            delete oldNode;
+            if (nodeOf(oldNode->key.id) == oldNode) {
+                nodeOfId[oldNode->key.id] = nullptr;
+            }
+            freeNode(oldNode);
         }
         balance(t);
+        return found;
     }
 
-    bool detectConflicts(const Event& event, AVLNode* t) const {
-        if (t == nullptr) {
+    // Interval-tree search: a subtree whose maxEnd is at or before the query
+    // start cannot overlap it, and nodes starting at or after the query's
+    // last end (its end, unless it repeats) rule out their whole right
+    // subtree.
+    bool detectConflicts(const Event& event, int lastEnd, AVLNode* t) const {
+        if (t == nullptr || t->maxEnd <= event.start) {
             return false;
         }
-        if (event.date == t->event.date && 
-            !(event.endTime <= t->event.startTime || event.startTime >= t->event.endTime)) {
+        if (detectConflicts(event, lastEnd, t->left)) {
             return true;
         }
-        return detectConflicts(event, t->left) || detectConflicts(event, t->right);
+        if (t->key.start >= lastEnd) {
+            return false;
+        }
+        if (t->key.id != event.id && overlapsKey(event, t->key)) {
+            return true;
+        }
+        return detectConflicts(event, lastEnd, t->right);
     }
-    void visualize(ofstream& outfile, AVLNode* t) const {
-        if (t->left) {
-            outfile << "\"" << t->event.name << "\\n" << t->event.date << "\\n" << t->event.startTime << "-" << t->event.endTime << "\" -> \"" << t->left->event.name << "\\n" << t->left->event.date << "\\n" << t->left->event.startTime << "-" << t->left->event.endTime << "\";\n";
-            visualize(outfile, t->left);
+
+    // Repeating events found here would only be matched on their first
+    // occurrence; findConflicts matches them separately
+    void findConflicts(const Event& event, int lastEnd, AVLNode* t, vector<Event>& out) const {
+        if (t == nullptr || t->maxEnd <= event.start) {
+            return;
         }
-        if (t->right) {
-            outfile << "\"" << t->event.name << "\\n" << t->event.date << "\\n" << t->event.startTime << "-" << t->event.endTime << "\" -> \"" << t->right->event.name << "\\n" << t->right->event.date << "\\n" << t->right->event.startTime << "-" << t->right->event.endTime << "\";\n";
-            visualize(outfile, t->right);
+        findConflicts(event, lastEnd, t->left, out);
+        if (t->key.start >= lastEnd) {
+            return;
+        }
+        if (t->key.id != event.id && overlapsKey(event, t->key) && !store->repeats(t->key.slot)) {
+            out.push_back(store->event(t->key.slot));
+        }
+        findConflicts(event, lastEnd, t->right, out);
+    }
+
+    // Whether an occurrence of event overlaps the filed times key, which
+    // starts before event's last end
+    static bool overlapsKey(const Event& event, const EventKey& key) {
+        if (event.repeats()) {
+            return event.occurrenceDuring(key.start, key.end) != -1;
+        }
+        return event.start < key.end;
+    }
+
+    // Latest end among each repeating event's first occurrence overlapping
+    // [from, to); INT_MIN if none does
+    int repeatBusyUntil(int from, int to) const {
+        int busyUntil = INT_MIN;
+        for (const auto& rule : store->recurrences()) {
+            Event series = store->times(rule.first);
+            long long k = series.occurrenceDuring(from, to);
+            if (k != -1) {
+                busyUntil = max(busyUntil, series.occurrence(k).end);
+            }
+        }
+        return busyUntil;
+    }
+
+    // Past this point a free-slot search starting at from has seen every
+    // distinct stretch of the calendar: every one-off event and bounded
+    // rule is over, and the endless rules repeat together every lcm of
+    // their periods
+    long long repeatHorizon(int from) const {
+        long long settled = max(from, root ? root->maxEnd : INT_MIN);
+        long long cycle = 1;
+        for (const auto& rule : store->recurrences()) {
+            Event series = store->times(rule.first);
+            if (series.occurrences() == LLONG_MAX) {
+                settled = max<long long>(settled, series.start);
+                long long period = series.recurrence.period();
+                cycle = min<long long>(cycle / Event::gcd(cycle, period) * period, 1LL << 40);
+            } else {
+                settled = max<long long>(settled, series.lastEnd());
+            }
+        }
+        return settled + cycle;
+    }
+
+    // Highest node of t's subtree starting in scope's range; the others
+    // in range all lie below it
+    AVLNode* topmostIn(AVLNode* t, const ExportScope& scope) const {
+        while (t != nullptr && !scope.inRange(t->key.start)) {
+            t = t->key.start < scope.from ? t->right : t->left;
+        }
+        return t;
+    }
+
+    // date, then start and end joined by timeSep
+    void writeWhen(ExportWriter& out, AVLNode* t, const char* dateSep, const char* timeSep) const {
+        int day = Event::floorDiv(t->key.start, 1440);
+        out << Event::formatDate(day) << dateSep << Event::formatTime(t->key.start - day * 1440) << timeSep
+            << Event::formatTime(t->key.end - day * 1440);
+    }
+
+    void exportDot(ExportWriter& out, AVLNode* t, const ExportScope& scope, size_t& written) const {
+        if (t == nullptr) {
+            return;
+        }
+        ++written;
+        out << t->key.id << " [label=\"";
+        out.quoted(store->name(t->key.slot)) << "\\n";
+        writeWhen(out, t, "\\n", "-");
+        out << "\"];\n";
+        for (AVLNode* child : {topmostIn(t->left, scope), topmostIn(t->right, scope)}) {
+            if (child != nullptr) {
+                out << t->key.id << " -> " << child->key.id << ";\n";
+                exportDot(out, child, scope, written);
+            }
+        }
+    }
+
+    void exportJson(ExportWriter& out, AVLNode* t, const ExportScope& scope, size_t& written) const {
+        if (t == nullptr) {
+            out << "null";
+            return;
         }
+        ++written;
+        out << "{\"id\":" << t->key.id << ",\"name\":\"";
+        out.quoted(store->name(t->key.slot)) << "\",\"left\":";
+        exportJson(out, topmostIn(t->left, scope), scope, written);
+        out << ",\"right\":";
+        exportJson(out, topmostIn(t->right, scope), scope, written);
+        out << '}';
     }
 
-    int height(AVLNode* t) const {
+    void exportCsv(ExportWriter& out, AVLNode* t, const ExportScope& scope, size_t& written) const {
+        if (t == nullptr) {
+            return;
+        }
+        ++written;
+        AVLNode* left = topmostIn(t->left, scope);
+        AVLNode* right = topmostIn(t->right, scope);
+        out << t->key.id << ',' << store->name(t->key.slot) << ',';
+        writeWhen(out, t, ",", ",");
+        out << ',';
+        if (left != nullptr) out << left->key.id;
+        out << ',';
+        if (right != nullptr) out << right->key.id;
+        out << '\n';
+        exportCsv(out, left, scope, written);
+        exportCsv(out, right, scope, written);
+    }
+
+    static int height(const AVLNode* t) {
         return t == nullptr ? -1 : t->height;
     }
 
+    static int size(const AVLNode* t) {
+        return t == nullptr ? 0 : t->size;
+    }
+
+    // Free-slot queries handed to a worker at a time
+    static constexpr size_t FREE_SLOT_CHUNK = 256;
+
+    // b - a, floored at 0 and capped at INT_MAX
+    static int gapBetween(int a, int b) {
+        return (int)min<long long>(max<long long>((long long)b - a, 0), INT_MAX);
+    }
+
+    // Free windows lie between each event's start and the latest end of
+    // everything before it. Walks t in time order with reach holding that
+    // latest end, skipping subtrees that cannot hold a window of duration
+    // at or after from; on success sets slot, otherwise leaves reach past t.
+    bool findFreeSlot(const AVLNode* t, int from, int duration, int& reach, int& slot) const {
+        if (t == nullptr) {
+            return false;
+        }
+        if (gapBetween(max(reach, from), t->minStart) < duration && t->maxGap < duration) {
+            reach = max(reach, t->maxEnd);
+            return false;
+        }
+        // Windows closing at or before t's start are too short after from
+        if (gapBetween(from, t->key.start) < duration) {
+            if (t->left && t->left->maxEnd > reach) reach = t->left->maxEnd;
+        } else if (findFreeSlot(t->left, from, duration, reach, slot)) {
+            return true;
+        }
+        if (gapBetween(max(reach, from), t->key.start) >= duration) {
+            slot = max(reach, from);
+            return true;
+        }
+        if (t->key.end > reach) reach = t->key.end;
+        return findFreeSlot(t->right, from, duration, reach, slot);
+    }
+
+    // Events starting before time
+    size_t countBefore(int time) const {
+        size_t count = 0;
+        for (const AVLNode* t = root; t != nullptr;) {
+            if (t->key.start < time) {
+                count += size(t->left) + 1;
+                t = t->right;
+            } else {
+                t = t->left;
+            }
+        }
+        return count;
+    }
+
+    AVLNode* nodeOf(int id) const {
+        if (id < 0 || id >= (int)nodeOfId.size()) {
+            return nullptr;
+        }
+        return nodeOfId[id];
+    }
+
+    // Negative ids mark throwaway query events and are never indexed
+    void index(AVLNode* t) {
+        int id = t->key.id;
+        if (id < 0) {
+            return;
+        }
+        if (id >= (int)nodeOfId.size()) {
+            nodeOfId.resize(max<size_t>(id + 1, nodeOfId.size() * 2), nullptr);
+        }
+        nodeOfId[id] = t;
+    }
+
+    void verify(const AVLNode* t, const AVLNode* parent, const AVLNode*& previous) const {
+        if (t == nullptr) {
+            return;
+        }
+        auto require = [t](bool holds, const char* what) {
+            if (!holds) {
+                throw runtime_error(string("AVLTree invariant broken at event ") + to_string(t->key.id) + ": " + what);
+            }
+        };
+        require(t->parent == parent, "parent link");
+        verify(t->left, t, previous);
+        require(previous == nullptr || previous->key < t->key, "order");
+        previous = t;
+        verify(t->right, t, previous);
+        require(abs(height(t->left) - height(t->right)) <= 1, "balance");
+        require(nodeOf(t->key.id) == t, "id index");
+        require(t->key.start == store->start(t->key.slot) && t->key.end == store->end(t->key.slot) &&
+                    t->key.id == store->id(t->key.slot),
+                "key matches store");
+        AVLNode copy = *t;
+        summarize(&copy);
+        require(copy.height == t->height, "height");
+        require(copy.size == t->size, "size");
+        require(copy.maxEnd == t->maxEnd, "maxEnd");
+        require(copy.minStart == t->minStart, "minStart");
+        require(copy.maxGap == t->maxGap, "maxGap");
+    }
+
+    // Recomputes the cached height, maxEnd, size, minStart and maxGap of t
+    // from its children and points the children back at it. maxGap bounds
+    // the widest window, within the subtree alone, between an event's start
+    // and the latest end before it. Each child's bound is taken as is, so
+    // it can be too generous where a long event covers later gaps.
+    void update(AVLNode* t) {
+        if (t->left) t->left->parent = t;
+        if (t->right) t->right->parent = t;
+        summarize(t);
+    }
+
+    // update() without touching the children, so verify() can recompute
+    // a copy
+    static void summarize(AVLNode* t) {
+        t->height = max(height(t->left), height(t->right)) + 1;
+        t->size = 1 + size(t->left) + size(t->right);
+        t->maxEnd = t->key.end;
+        if (t->left && t->left->maxEnd > t->maxEnd) t->maxEnd = t->left->maxEnd;
+        if (t->right && t->right->maxEnd > t->maxEnd) t->maxEnd = t->right->maxEnd;
+        t->minStart = t->left ? t->left->minStart : t->key.start;
+        t->maxGap = 0;
+        int reach = t->key.end;
+        if (t->left) {
+            t->maxGap = max(t->left->maxGap, gapBetween(t->left->maxEnd, t->key.start));
+            reach = max(reach, t->left->maxEnd);
+        }
+        if (t->right) {
+            t->maxGap = max({t->maxGap, t->right->maxGap, gapBetween(reach, t->right->minStart)});
+        }
+    }
+
     void rotateWithLeftChild(AVLNode*& k2) {
         AVLNode* k1 = k2->left;
         k2->left = k1->right;
         k1->right = k2;
-        k2->height = max(height(k2->left), height(k2->right)) + 1;
-        k1->height = max(height(k1->left), k2->height) + 1;
+        update(k2);
+        update(k1);
         k2 = k1;
     }
 
@@ -207,8 +1000,8 @@ private:
         AVLNode* k2 = k1->right;
         k1->right = k2->left;
         k2->left = k1;
-        k1->height = max(height(k1->left), height(k1->right)) + 1;
-        k2->height = max(height(k2->right), k1->height) + 1;
+        update(k1);
+        update(k2);
         k1 = k2;
     }
 
@@ -222,6 +1015,289 @@ private:
         rotateWithRightChild(k1);
     }
 
+    // Joins l, k and r, where every key in l is below k's and every key in
+    // r above it, into one balanced tree; O(|height(l) - height(r)|)
+    AVLNode* join(AVLNode* l, AVLNode* k, AVLNode* r) {
+        if (height(l) > height(r) + 1) {
+            return joinRight(l, k, r);
+        }
+        if (height(r) > height(l) + 1) {
+            return joinLeft(l, k, r);
+        }
+        k->left = l;
+        k->right = r;
+        update(k);
+        return k;
+    }
+
+    // l is taller: k and r go in down its right spine, where the heights
+    // first come within one, and rotations restore balance on the way up
+    AVLNode* joinRight(AVLNode* l, AVLNode* k, AVLNode* r) {
+        AVLNode* c = l->right;
+        if (height(c) <= height(r) + 1) {
+            k->left = c;
+            k->right = r;
+            update(k);
+            l->right = k;
+            if (height(k) > height(l->left) + 1) {
+                doubleWithRightChild(l);
+            } else {
+                update(l);
+            }
+            return l;
+        }
+        l->right = joinRight(c, k, r);
+        if (height(l->right) > height(l->left) + 1) {
+            rotateWithRightChild(l);
+        } else {
+            update(l);
+        }
+        return l;
+    }
+
+    AVLNode* joinLeft(AVLNode* l, AVLNode* k, AVLNode* r) {
+        AVLNode* c = r->left;
+        if (height(c) <= height(l) + 1) {
+            k->left = l;
+            k->right = c;
+            update(k);
+            r->left = k;
+            if (height(k) > height(r->right) + 1) {
+                doubleWithLeftChild(r);
+            } else {
+                update(r);
+            }
+            return r;
+        }
+        r->left = joinLeft(l, k, c);
+        if (height(r->left) > height(r->right) + 1) {
+            rotateWithLeftChild(r);
+        } else {
+            update(r);
+        }
+        return r;
+    }
+
+    // Joins two trees, every key in l below every key in r, by taking l's
+    // last node as the middle key
+    AVLNode* join2(AVLNode* l, AVLNode* r) {
+        if (l == nullptr) {
+            return r;
+        }
+        AVLNode* last;
+        AVLNode* rest = splitLast(l, last);
+        return join(rest, last, r);
+    }
+
+    AVLNode* splitLast(AVLNode* t, AVLNode*& last) {
+        if (t->right == nullptr) {
+            last = t;
+            return t->left;
+        }
+        AVLNode* rest = splitLast(t->right, last);
+        return join(t->left, t, rest);
+    }
+
+    // Cuts t into the keys below key (l) and above it (r) in O(log n);
+    // returns the node holding key itself, detached, or nullptr. l and r
+    // may alias t.
+    AVLNode* split(AVLNode* t, const EventKey& key, AVLNode*& l, AVLNode*& r) {
+        if (t == nullptr) {
+            l = r = nullptr;
+            return nullptr;
+        }
+        AVLNode* below = t->left;
+        AVLNode* above = t->right;
+        AVLNode* found;
+        if (key < t->key) {
+            AVLNode* middle;
+            found = split(below, key, l, middle);
+            r = join(middle, t, above);
+        } else if (t->key < key) {
+            AVLNode* middle;
+            found = split(above, key, middle, r);
+            l = join(below, t, middle);
+        } else {
+            t->left = t->right = nullptr;
+            l = below;
+            r = above;
+            found = t;
+        }
+        return found;
+    }
+
+    // a and b's keys together; where both hold a key a's node stays and
+    // b's goes to dropped
+    AVLNode* unite(AVLNode* a, AVLNode* b, vector<AVLNode*>& dropped) {
+        if (a == nullptr) return b;
+        if (b == nullptr) return a;
+        AVLNode* al = a->left;
+        AVLNode* ar = a->right;
+        AVLNode *bl, *br;
+        if (AVLNode* same = split(b, a->key, bl, br)) {
+            dropped.push_back(same);
+        }
+        AVLNode* l = unite(al, bl, dropped);
+        AVLNode* r = unite(ar, br, dropped);
+        return join(l, a, r);
+    }
+
+    // a without b's keys; b, possibly another tree's, is only read
+    AVLNode* subtract(AVLNode* a, const AVLNode* b, vector<AVLNode*>& dropped) {
+        if (a == nullptr || b == nullptr) return a;
+        AVLNode *al, *ar;
+        if (AVLNode* same = split(a, b->key, al, ar)) {
+            dropped.push_back(same);
+        }
+        AVLNode* l = subtract(al, b->left, dropped);
+        AVLNode* r = subtract(ar, b->right, dropped);
+        return join2(l, r);
+    }
+
+    // Below this height a set operation is not worth spreading out
+    static constexpr int PARALLEL_HEIGHT = 14;
+
+    // One independent piece of a set operation, and the caller's record of
+    // how the pieces were split off: leaves point at a piece, inner steps
+    // rejoin their two halves around pivot (or with join2 if none)
+    struct SetPiece {
+        AVLNode* a;
+        AVLNode* b;
+        AVLNode* result;
+        vector<AVLNode*> dropped;
+    };
+
+    struct SetStep {
+        bool leaf;
+        AVLNode* pivot;
+        size_t piece;
+    };
+
+    // unite or subtract. With workers, the caller splits both trees a few
+    // levels down into about four pieces per worker, the pieces run across
+    // the pool, and the caller joins the results back up in the order it
+    // split them. Pieces neither allocate nor touch the id index, so they
+    // share nothing.
+    AVLNode* setOperation(AVLNode* a, AVLNode* b, bool isUnion, ThreadPool* workers, vector<AVLNode*>& dropped) {
+        auto run = [this, isUnion](AVLNode* x, AVLNode* y, vector<AVLNode*>& out) {
+            return isUnion ? unite(x, y, out) : subtract(x, y, out);
+        };
+        if (workers == nullptr || workers->size() < 2 || max(height(a), height(b)) < PARALLEL_HEIGHT) {
+            return run(a, b, dropped);
+        }
+        int depth = 1;
+        while (((size_t)1 << depth) < workers->size() * 4) {
+            ++depth;
+        }
+        vector<SetPiece> pieces;
+        vector<SetStep> steps;
+        planSetOperation(a, b, isUnion, depth, pieces, steps, dropped);
+        workers->parallelFor(pieces.size(), [&](size_t i) {
+            pieces[i].result = run(pieces[i].a, pieces[i].b, pieces[i].dropped);
+        });
+        for (const SetPiece& piece : pieces) {
+            dropped.insert(dropped.end(), piece.dropped.begin(), piece.dropped.end());
+        }
+        size_t next = 0;
+        return assemble(steps, next, pieces);
+    }
+
+    // The first levels of unite or subtract, with the recursion recorded
+    // in steps instead of made
+    void planSetOperation(AVLNode* a, AVLNode* b, bool isUnion, int depth, vector<SetPiece>& pieces,
+                          vector<SetStep>& steps, vector<AVLNode*>& dropped) {
+        if (depth == 0 || a == nullptr || b == nullptr) {
+            steps.push_back({true, nullptr, pieces.size()});
+            pieces.push_back({a, b, nullptr, {}});
+            return;
+        }
+        AVLNode *l1, *r1, *l2, *r2;
+        AVLNode* same;
+        if (isUnion) {
+            l1 = a->left;
+            r1 = a->right;
+            same = split(b, a->key, l2, r2);
+            steps.push_back({false, a, 0});
+        } else {
+            l2 = b->left;
+            r2 = b->right;
+            same = split(a, b->key, l1, r1);
+            steps.push_back({false, nullptr, 0});
+        }
+        if (same != nullptr) {
+            dropped.push_back(same);
+        }
+        planSetOperation(l1, l2, isUnion, depth - 1, pieces, steps, dropped);
+        planSetOperation(r1, r2, isUnion, depth - 1, pieces, steps, dropped);
+    }
+
+    AVLNode* assemble(const vector<SetStep>& steps, size_t& next, vector<SetPiece>& pieces) {
+        const SetStep& step = steps[next++];
+        if (step.leaf) {
+            return pieces[step.piece].result;
+        }
+        AVLNode* l = assemble(steps, next, pieces);
+        AVLNode* r = assemble(steps, next, pieces);
+        return step.pivot != nullptr ? join(l, step.pivot, r) : join2(l, r);
+    }
+
+    // t's nodes in order
+    void collect(AVLNode* t, vector<AVLNode*>& out) const {
+        if (t != nullptr) {
+            collect(t->left, out);
+            out.push_back(t);
+            collect(t->right, out);
+        }
+    }
+
+    // A balanced subtree of new nodes for the events of nodes, which are in
+    // order and whose slots are in source. Events are copied into this
+    // tree's store unless source is that store. An id filed here under
+    // other times is unfiled first, so the incoming version wins; one
+    // filed under the same times keeps its node in the index, and the
+    // set operation drops the copy.
+    AVLNode* adopt(const vector<AVLNode*>& nodes, const EventStore& source) {
+        bool sameStore = &source == store;
+        if (!sameStore && !ownsStore()) {
+            throw runtime_error("A tree over a shared store only takes events from trees over the same store");
+        }
+        vector<EventKey> keys;
+        keys.reserve(nodes.size());
+        for (const AVLNode* node : nodes) {
+            EventKey key = node->key;
+            if (!sameStore) {
+                AVLNode* filed = nodeOf(key.id);
+                if (filed != nullptr && (filed->key.start != key.start || filed->key.end != key.end)) {
+                    unfile(filed->key);
+                }
+                key.slot = store->add(source.event(key.slot));
+            }
+            keys.push_back(key);
+        }
+        return buildFromSorted(keys, 0, keys.size());
+    }
+
+    // Frees nodes cut out of the tree. Those holding an event's indexed
+    // copy take it out of the index, and out of the store if it is ours.
+    void discard(const vector<AVLNode*>& nodes) {
+        for (AVLNode* node : nodes) {
+            if (nodeOf(node->key.id) == node) {
+                nodeOfId[node->key.id] = nullptr;
+                if (ownsStore()) {
+                    store->remove(node->key.id);
+                }
+            }
+            freeNode(node);
+        }
+    }
+
+    AVLNode* findMax(AVLNode* t) const {
+        while (t != nullptr && t->right != nullptr) {
+            t = t->right;
+        }
+        return t;
+    }
+
     AVLNode* findMin(AVLNode* t) const {
         if (t == nullptr) {
             return nullptr;
@@ -249,15 +1325,40 @@ private:
                 doubleWithRightChild(t);
             }
         }
-        t->height = max(height(t->left), height(t->right)) + 1;
+        update(t);
+    }
+
+    // Nodes come from a per-tree slab pool; build with -DAVLTREE_NO_POOL to
+    // fall back to plain new/delete for comparison
+    AVLNode* newNode(const EventKey& key, AVLNode* lt, AVLNode* rt) {
+#ifndef AVLTREE_NO_POOL
+        return pool.create(key, lt, rt);
+#else
+        return new AVLNode(key, lt, rt);
+#endif
+    }
+
+    void freeNode(AVLNode* t) {
+#ifndef AVLTREE_NO_POOL
+        pool.destroy(t);
+#else
+        delete t;
+#endif
     }
 
+    // Only ever called on the root, so with the pool every node goes at once;
+    // nodes own nothing, so there are no destructors to run first
     void makeEmpty(AVLNode*& t) {
+#ifndef AVLTREE_NO_POOL
+        static_assert(is_trivially_destructible<AVLNode>::value, "AVLNode must not own resources");
+        pool.releaseAll();
+#else
         if (t != nullptr) {
             makeEmpty(t->left);
             makeEmpty(t->right);
             delete t;
         }
+#endif
         t = nullptr;
     }
 };
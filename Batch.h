@@ -0,0 +1,339 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <climits>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <stdexcept>
+#include <tuple>
+#include "Csv.h"
+#include "Scheduler.h"
+
+using namespace std;
+
+// Headless command processor. Each input line is one command, fields
+// comma separated like events.txt:
+//   create,name,date,start,end[,everyDays[,untilDate]]
+//                                     repeats every so many days, until
+//                                     the date if one is given
+//   update,id,name,date,start,end[,everyDays[,untilDate]]
+//                                     empty fields keep the current value;
+//                                     everyDays 0 makes it a one-off
+//   delete,id
+//   depend,fromId,toId                toId depends on fromId
+//   toposort
+//   query,fromDate,toDate             inclusive; empty bounds are open; lists
+//                                     each occurrence of a repeating event
+//   count,fromDate,toDate             events filed in the range; a repeating
+//                                     event counts once, at its first date
+//   page,fromDate,toDate,page,size    one page of count's events, pages from 0;
+//                                     ok,page,<rows>,<pages>
+//   conflicts,date,start,end
+//   free,date,time,minutes[,date,time,minutes...]
+//                                     earliest free window of each length at
+//                                     or after each time, as slot,date,start,
+//                                     date,end; many at once run in parallel
+//   find,id
+//   audit                             every overlapping pair, as conflict,id,id;
+//                                     a repeating event on every occurrence,
+//                                     each pair once
+//   timing,id                         timing,id,earliest date,time,latest date,time,slack minutes
+//   critical                          the critical path as event rows
+//   violations                        dependencies broken by the current times, as violation,from,to
+//   export,what,format,file[,fromDate,toDate[,id...]]
+//                                     what is graph or tree, format dot,
+//                                     json or csv; dates as for query; ids
+//                                     narrow a graph export to those events
+//                                     and everything before or after them
+//   save                              fold the journal into the events file
+// Blank lines and lines starting with # are skipped. Every command writes
+// one result line, "ok,<command>[,...]" or "error,<command>,<message>",
+// preceded by any "event,id,name,date,start,end" rows it returns. Rows of
+// repeating events end with their rule, R:every[:until date].
+
+struct BatchStats {
+    size_t commands = 0;
+    size_t errors = 0;
+};
+
+inline void writeEventRow(string& out, const Event& event) {
+    out += "event,";
+    out += to_string(event.id);
+    out += ',';
+    out += event.name;
+    out += ',';
+    out += event.date();
+    out += ',';
+    out += event.startTime();
+    out += ',';
+    out += event.endTime();
+    if (event.repeats()) {
+        out += ',';
+        out += event.recurrence.field();
+    }
+    out += '\n';
+}
+
+// Minutes since epoch as "date,time"
+inline string formatMinutes(int minutes) {
+    int day = Event::floorDiv(minutes, 1440);
+    return Event::formatDate(day) + "," + Event::formatTime(minutes - day * 1440);
+}
+
+inline int parseId(string_view field) {
+    int id;
+    if (!parseCsvInt(field, id)) {
+        throw runtime_error("Invalid event id");
+    }
+    return id;
+}
+
+// Trailing everyDays[,untilDate] fields; none when everyDays is empty
+inline optional<Recurrence> parseRecurrence(string_view every, string_view until) {
+    if (every.empty()) {
+        return nullopt;
+    }
+    Recurrence recurrence;
+    if (!parseCsvInt(every, recurrence.every)) {
+        throw runtime_error("Invalid repeat interval");
+    }
+    if (!until.empty()) {
+        if (!Event::isValidDate(until)) {
+            throw runtime_error("Invalid date format, expected YYYY-MM-DD");
+        }
+        recurrence.until = Event::parseDate(until);
+    }
+    return recurrence;
+}
+
+// Inclusive dates as minutes [from, to); empty bounds are open
+inline pair<int, int> parseDateRange(string_view from, string_view to) {
+    if ((!from.empty() && !Event::isValidDate(from)) || (!to.empty() && !Event::isValidDate(to))) {
+        throw runtime_error("Invalid date format, expected YYYY-MM-DD");
+    }
+    return {from.empty() ? INT_MIN : Event::parseDate(from) * 1440,
+            to.empty() ? INT_MAX : (Event::parseDate(to) + 1) * 1440};
+}
+
+// Runs one command line and appends its output to out. Returns false if
+// the command failed.
+inline bool runCommand(Scheduler& scheduler, string_view line, string& out) {
+    string_view command = nextCsvField(line);
+    size_t rowsStart = out.size();
+    try {
+        if (command == "create") {
+            string name(nextCsvField(line));
+            string date(nextCsvField(line));
+            string startTime(nextCsvField(line));
+            string endTime(nextCsvField(line));
+            string_view every = nextCsvField(line);
+            string_view until = nextCsvField(line);
+            int id = scheduler.createEvent(name, date, startTime, endTime,
+                                           parseRecurrence(every, until).value_or(Recurrence()));
+            out += "ok,create," + to_string(id) + "\n";
+        } else if (command == "update") {
+            int id = parseId(nextCsvField(line));
+            string name(nextCsvField(line));
+            string date(nextCsvField(line));
+            string startTime(nextCsvField(line));
+            string endTime(nextCsvField(line));
+            string_view every = nextCsvField(line);
+            string_view until = nextCsvField(line);
+            scheduler.updateEvent(id, name, date, startTime, endTime, parseRecurrence(every, until));
+            out += "ok,update," + to_string(id) + "\n";
+        } else if (command == "delete") {
+            int id = parseId(nextCsvField(line));
+            scheduler.deleteEvent(id);
+            out += "ok,delete," + to_string(id) + "\n";
+        } else if (command == "depend") {
+            int fromEventId = parseId(nextCsvField(line));
+            int toEventId = parseId(nextCsvField(line));
+            scheduler.addDependency(fromEventId, toEventId);
+            out += "ok,depend," + to_string(fromEventId) + "," + to_string(toEventId) + "\n";
+        } else if (command == "toposort") {
+            vector<Event> sorted = scheduler.topologicalSort();
+            for (const auto& event : sorted) {
+                writeEventRow(out, event);
+            }
+            out += "ok,toposort," + to_string(sorted.size()) + "\n";
+        } else if (command == "query") {
+            string_view from = nextCsvField(line);
+            string_view to = nextCsvField(line);
+            pair<int, int> range = parseDateRange(from, to);
+            // Filed events merged in time order with the later occurrences
+            // of repeating ones, which are only expanded for this range
+            vector<Event> repeats = scheduler.repeatsBetween(range.first, range.second);
+            auto next = repeats.begin();
+            size_t count = repeats.size();
+            for (const Event& event : scheduler.eventsBetween(range.first, range.second)) {
+                for (; next != repeats.end() && *next < event; ++next) {
+                    writeEventRow(out, *next);
+                }
+                writeEventRow(out, event);
+                ++count;
+            }
+            for (; next != repeats.end(); ++next) {
+                writeEventRow(out, *next);
+            }
+            out += "ok,query," + to_string(count) + "\n";
+        } else if (command == "count") {
+            string_view from = nextCsvField(line);
+            string_view to = nextCsvField(line);
+            pair<int, int> range = parseDateRange(from, to);
+            out += "ok,count," + to_string(scheduler.countBetween(range.first, range.second)) + "\n";
+        } else if (command == "page") {
+            string_view from = nextCsvField(line);
+            string_view to = nextCsvField(line);
+            pair<int, int> range = parseDateRange(from, to);
+            int page, pageSize;
+            if (!parseCsvInt(nextCsvField(line), page) || !parseCsvInt(nextCsvField(line), pageSize) || page < 0 ||
+                pageSize <= 0) {
+                throw runtime_error("Invalid page or page size");
+            }
+            size_t count = 0;
+            for (const Event& event : scheduler.eventsPage(range.first, range.second, page, pageSize)) {
+                writeEventRow(out, event);
+                ++count;
+            }
+            size_t total = scheduler.countBetween(range.first, range.second);
+            out += "ok,page," + to_string(count) + "," + to_string((total + pageSize - 1) / pageSize) + "\n";
+        } else if (command == "conflicts") {
+            string date(nextCsvField(line));
+            string startTime(nextCsvField(line));
+            string endTime(nextCsvField(line));
+            if (!Event::isValidDate(date) || !Event::isValidTime(startTime) || !Event::isValidEndTime(endTime)) {
+                throw runtime_error("Invalid date or time format");
+            }
+            vector<Event> conflicts = scheduler.conflictsWith(Event(-1, "", date, startTime, endTime));
+            for (const auto& event : conflicts) {
+                writeEventRow(out, event);
+            }
+            out += "ok,conflicts," + to_string(conflicts.size()) + "\n";
+        } else if (command == "free") {
+            vector<pair<int, int>> queries;
+            while (!line.empty()) {
+                string date(nextCsvField(line));
+                string time(nextCsvField(line));
+                int duration;
+                if (!Event::isValidDate(date) || !Event::isValidTime(time)) {
+                    throw runtime_error("Invalid date or time format");
+                }
+                if (!parseCsvInt(nextCsvField(line), duration) || duration <= 0) {
+                    throw runtime_error("Invalid duration");
+                }
+                queries.emplace_back(Event::toMinutes(date, time), duration);
+            }
+            if (queries.empty()) {
+                throw runtime_error("Missing date, time and duration");
+            }
+            vector<int> slots = scheduler.freeSlots(queries);
+            for (size_t i = 0; i < slots.size(); ++i) {
+                out += "slot," + formatMinutes(slots[i]) + "," + formatMinutes(slots[i] + queries[i].second) + "\n";
+            }
+            out += "ok,free," + to_string(slots.size()) + "\n";
+        } else if (command == "audit") {
+            ConflictPairs pairs = scheduler.auditConflicts();
+            for (const auto& conflict : pairs) {
+                out += "conflict,";
+                out += to_string(conflict.first);
+                out += ',';
+                out += to_string(conflict.second);
+                out += '\n';
+            }
+            out += "ok,audit," + to_string(pairs.size()) + "\n";
+        } else if (command == "timing") {
+            EventTiming timing = scheduler.timing(parseId(nextCsvField(line)));
+            out += "timing," + to_string(timing.id) + "," + formatMinutes(timing.earliestStart) + "," +
+                   formatMinutes(timing.latestStart) + "," + to_string(timing.slack) + "\n";
+            out += "ok,timing\n";
+        } else if (command == "critical") {
+            vector<Event> path = scheduler.criticalPath();
+            for (const auto& event : path) {
+                writeEventRow(out, event);
+            }
+            out += "ok,critical," + to_string(path.size()) + "\n";
+        } else if (command == "violations") {
+            vector<pair<int, int>> violations = scheduler.violatedDependencies();
+            for (const auto& dependency : violations) {
+                out += "violation," + to_string(dependency.first) + "," + to_string(dependency.second) + "\n";
+            }
+            out += "ok,violations," + to_string(violations.size()) + "\n";
+        } else if (command == "find") {
+            writeEventRow(out, scheduler.findEvent(parseId(nextCsvField(line))));
+            out += "ok,find\n";
+        } else if (command == "export") {
+            string_view what = nextCsvField(line);
+            ExportFormat format = parseExportFormat(nextCsvField(line));
+            string path(nextCsvField(line));
+            if (path.empty()) {
+                throw runtime_error("Missing export file");
+            }
+            ExportScope scope;
+            string_view from = nextCsvField(line);
+            string_view to = nextCsvField(line);
+            tie(scope.from, scope.to) = parseDateRange(from, to);
+            while (!line.empty()) {
+                scope.ids.push_back(parseId(nextCsvField(line)));
+            }
+            size_t count;
+            if (what != "graph" && what != "tree") {
+                throw runtime_error("Unknown export, expected graph or tree");
+            }
+            ExportWriter file(path);
+            if (what == "graph") {
+                count = scheduler.getGraph().exportTo(file, format, scope);
+            } else {
+                count = scheduler.getTree().exportTo(file, format, scope);
+            }
+            file.close();
+            out += "ok,export," + to_string(count) + "\n";
+        } else if (command == "save") {
+            scheduler.compact();
+            out += "ok,save\n";
+        } else {
+            throw runtime_error("Unknown command");
+        }
+    } catch (const runtime_error& e) {
+        // Drop partial rows so a failed command yields just its error line
+        out.resize(rowsStart);
+        out += "error,";
+        out += command;
+        out += ",";
+        out += e.what();
+        out += "\n";
+        return false;
+    }
+    return true;
+}
+
+// Reads commands from in until EOF and writes results to out, flushing in
+// large blocks rather than per line
+inline BatchStats runBatch(Scheduler& scheduler, istream& in, ostream& out) {
+    BatchStats stats;
+    string line;
+    string buffer;
+    while (getline(in, line)) {
+        string_view view(line);
+        if (!view.empty() && view.back() == '\r') {
+            view.remove_suffix(1);
+        }
+        if (view.empty() || view[0] == '#') {
+            continue;
+        }
+        ++stats.commands;
+        if (!runCommand(scheduler, view, buffer)) {
+            ++stats.errors;
+        }
+        if (buffer.size() >= 1 << 16) {
+            out << buffer;
+            buffer.clear();
+        }
+    }
+    out << buffer;
+    out.flush();
+    return stats;
+}
+
+#endif // BATCH_H
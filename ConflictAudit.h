@@ -0,0 +1,189 @@
+#ifndef CONFLICTAUDIT_H
+#define CONFLICTAUDIT_H
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+#include "AVLTree.h"
+#include "ThreadPool.h"
+
+using namespace std;
+
+// Whole-calendar conflict audit. Scheduler::validate keeps every event
+// within its own date (it ends by 24:00), so two one-off events can only
+// overlap on the same date: the calendar is cut into dates, each date is
+// sorted and swept independently, and the dates are spread over a thread
+// pool. Cost is O(n log n + conflicts) in total. Repeating events are
+// few; each is matched on every occurrence by the tree's own conflict
+// search instead, also in parallel.
+
+// Just the fields the sweep needs, so the per-date sort moves 12 bytes
+// per event rather than whole Events
+struct EventSpan {
+    int start;
+    int end;
+    int id;
+
+    bool operator<(const EventSpan& other) const {
+        if (start != other.start) return start < other.start;
+        return end < other.end;
+    }
+};
+
+// Overlapping pairs as (id, id), the earlier-starting event first
+using ConflictPairs = vector<pair<int, int>>;
+
+// Sweeps one date's spans: the active set holds the events still running
+// at the current start time, as a min-heap on end time
+inline void sweepDate(EventSpan* first, EventSpan* last, vector<EventSpan>& active, ConflictPairs& out) {
+    sort(first, last);
+    auto endsLater = [](const EventSpan& a, const EventSpan& b) { return a.end > b.end; };
+    active.clear();
+    for (EventSpan* e = first; e != last; ++e) {
+        while (!active.empty() && active.front().end <= e->start) {
+            pop_heap(active.begin(), active.end(), endsLater);
+            active.pop_back();
+        }
+        for (const EventSpan& a : active) {
+            // a.start <= e->start < a.end; only a zero-length e at the
+            // same minute as a's start fails to overlap
+            if (a.start < e->end) {
+                out.emplace_back(a.id, e->id);
+            }
+        }
+        active.push_back(*e);
+        push_heap(active.begin(), active.end(), endsLater);
+    }
+}
+
+// Audits spans in any order and returns every overlapping pair, grouped
+// by date in date order
+inline ConflictPairs auditConflicts(vector<EventSpan> spans, ThreadPool& pool) {
+    if (spans.empty()) {
+        return {};
+    }
+
+    // Partition by date with a counting sort, falling back to a sort when
+    // the dates are too sparse for a bucket per day
+    auto dayOf = [](const EventSpan& s) { return Event::floorDiv(s.start, 1440); };
+    int firstDay = dayOf(spans[0]);
+    int lastDay = firstDay;
+    for (const EventSpan& s : spans) {
+        firstDay = min(firstDay, dayOf(s));
+        lastDay = max(lastDay, dayOf(s));
+    }
+    vector<size_t> dateStarts;
+    if ((size_t)(lastDay - firstDay) <= 2 * spans.size() + 1024) {
+        vector<size_t> offsets(lastDay - firstDay + 2, 0);
+        for (const EventSpan& s : spans) {
+            ++offsets[dayOf(s) - firstDay + 1];
+        }
+        for (size_t d = 1; d < offsets.size(); ++d) {
+            offsets[d] += offsets[d - 1];
+        }
+        vector<EventSpan> byDate(spans.size());
+        vector<size_t> cursor(offsets.begin(), offsets.end() - 1);
+        for (const EventSpan& s : spans) {
+            byDate[cursor[dayOf(s) - firstDay]++] = s;
+        }
+        spans.swap(byDate);
+        for (size_t d = 0; d + 1 < offsets.size(); ++d) {
+            if (offsets[d] != offsets[d + 1]) {
+                dateStarts.push_back(offsets[d]);
+            }
+        }
+    } else {
+        sort(spans.begin(), spans.end(), [&](const EventSpan& a, const EventSpan& b) {
+            return dayOf(a) < dayOf(b);
+        });
+        for (size_t i = 0; i < spans.size(); ++i) {
+            if (i == 0 || dayOf(spans[i]) != dayOf(spans[i - 1])) {
+                dateStarts.push_back(i);
+            }
+        }
+    }
+    dateStarts.push_back(spans.size());
+    size_t dates = dateStarts.size() - 1;
+
+    // Hand out runs of whole dates of about equal event counts, a few per
+    // worker so one crowded date does not leave the others idle
+    size_t chunks = min(dates, pool.size() * 4);
+    size_t target = (spans.size() + chunks - 1) / chunks;
+    vector<size_t> chunkDates{0};
+    for (size_t d = 1; d < dates; ++d) {
+        if (dateStarts[d] - dateStarts[chunkDates.back()] >= target) {
+            chunkDates.push_back(d);
+        }
+    }
+    chunkDates.push_back(dates);
+
+    vector<ConflictPairs> found(chunkDates.size() - 1);
+    pool.parallelFor(found.size(), [&](size_t c) {
+        vector<EventSpan> active;
+        for (size_t d = chunkDates[c]; d < chunkDates[c + 1]; ++d) {
+            sweepDate(spans.data() + dateStarts[d], spans.data() + dateStarts[d + 1], active, found[c]);
+        }
+    });
+
+    size_t total = 0;
+    for (const auto& part : found) {
+        total += part.size();
+    }
+    ConflictPairs pairs;
+    pairs.reserve(total);
+    for (const auto& part : found) {
+        pairs.insert(pairs.end(), part.begin(), part.end());
+    }
+    return pairs;
+}
+
+// Audits everything stored in the tree: the one-off pairs by date, then
+// each pair involving a repeating event once, in order of the earlier
+// event's first occurrence. A repeating event's search walks every event
+// filed up to its last occurrence, so an endless rule walks the rest of
+// the calendar.
+inline ConflictPairs auditConflicts(const AVLTree& tree, ThreadPool& pool) {
+    vector<EventSpan> spans;
+    vector<Event> series;
+    for (auto it = tree.begin(); it != tree.end(); ++it) {
+        if (it.repeats()) {
+            series.push_back(*it);
+        } else {
+            spans.push_back({it.key().start, it.key().end, it.key().id});
+        }
+    }
+    ConflictPairs pairs = auditConflicts(move(spans), pool);
+    if (series.empty()) {
+        return pairs;
+    }
+
+    // Each clashing event comes back once. Two series find each other;
+    // only the earlier one reports the pair. Pairs carry the earlier
+    // event's start to be put in order.
+    vector<vector<pair<int, pair<int, int>>>> found(series.size());
+    pool.parallelFor(series.size(), [&](size_t i) {
+        const Event& event = series[i];
+        for (const Event& other : tree.findConflicts(event)) {
+            if (other.repeats() && other < event) {
+                continue;
+            }
+            if (other < event) {
+                found[i].push_back({other.start, {other.id, event.id}});
+            } else {
+                found[i].push_back({event.start, {event.id, other.id}});
+            }
+        }
+    });
+    vector<pair<int, pair<int, int>>> repeating;
+    for (const auto& part : found) {
+        repeating.insert(repeating.end(), part.begin(), part.end());
+    }
+    stable_sort(repeating.begin(), repeating.end(),
+                [](const auto& a, const auto& b) { return a.first < b.first; });
+    for (const auto& clash : repeating) {
+        pairs.push_back(clash.second);
+    }
+    return pairs;
+}
+
+#endif // CONFLICTAUDIT_H
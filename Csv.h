@@ -0,0 +1,27 @@
+#ifndef CSV_H
+#define CSV_H
+
+#include <charconv>
+#include <string_view>
+#include <system_error>
+
+using namespace std;
+
+// Field helpers shared by the events file loader, the journal and the
+// command parsers. Fields are comma separated with no quoting, matching
+// the events.txt layout.
+
+// Returns the next field and advances line past it and its comma
+inline string_view nextCsvField(string_view& line) {
+    size_t comma = line.find(',');
+    string_view field = line.substr(0, comma);
+    line.remove_prefix(comma == string_view::npos ? line.size() : comma + 1);
+    return field;
+}
+
+inline bool parseCsvInt(string_view field, int& value) {
+    auto result = from_chars(field.data(), field.data() + field.size(), value);
+    return result.ec == errc() && result.ptr == field.data() + field.size() && !field.empty();
+}
+
+#endif // CSV_H
@@ -0,0 +1,218 @@
+#ifndef EDGESTORE_H
+#define EDGESTORE_H
+
+#include <algorithm>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+// Directed edges between node slots, stored once in compressed sparse row
+// form with a reverse (predecessor) index alongside. Edges added since the
+// last compact() sit in a small per-node delta; removed base edges are
+// tombstoned in place. Iteration always sees base + delta, and compact()
+// folds the delta back in and squeezes out tombstones.
+class EdgeStore {
+public:
+    // Replaces everything with the given (from, to) edges over n nodes.
+    // Duplicate edges are dropped.
+    void build(vector<pair<int, int>>& edges, size_t n) {
+        sort(edges.begin(), edges.end());
+        edges.erase(unique(edges.begin(), edges.end()), edges.end());
+        nodes = n;
+        fillCsr(edges, outOffsets, outTargets, false);
+        fillCsr(edges, inOffsets, inSources, true);
+        deltaOut.clear();
+        deltaIn.clear();
+        deltaEdges = 0;
+        deadEdges = 0;
+    }
+
+    void clear() {
+        vector<pair<int, int>> none;
+        build(none, 0);
+    }
+
+    // Makes room for slots up to n - 1; new slots start without edges
+    void resize(size_t n) {
+        nodes = max(nodes, n);
+    }
+
+    size_t edgeCount() const {
+        return outTargets.size() - deadEdges + deltaEdges;
+    }
+
+    void addEdge(int from, int to) {
+        deltaOut[from].push_back(to);
+        deltaIn[to].push_back(from);
+        if (++deltaEdges > max<size_t>(1024, outTargets.size() / 4)) {
+            compact();
+        }
+    }
+
+    bool hasEdge(int from, int to) const {
+        bool found = false;
+        forEachSuccessor(from, [&](int w) { found = found || w == to; });
+        return found;
+    }
+
+    size_t inDegree(int v) const {
+        size_t degree = 0;
+        forEachPredecessor(v, [&](int) { ++degree; });
+        return degree;
+    }
+
+    // Drops one edge; false if there is none
+    bool removeEdge(int from, int to) {
+        auto it = deltaOut.find(from);
+        if (it != deltaOut.end()) {
+            auto found = find(it->second.begin(), it->second.end(), to);
+            if (found != it->second.end()) {
+                it->second.erase(found);
+                if (it->second.empty()) {
+                    deltaOut.erase(it);
+                }
+                auto back = deltaIn.find(to);
+                back->second.erase(find(back->second.begin(), back->second.end(), from));
+                if (back->second.empty()) {
+                    deltaIn.erase(back);
+                }
+                --deltaEdges;
+                return true;
+            }
+        }
+        if ((size_t)from + 1 >= outOffsets.size() || (size_t)to + 1 >= inOffsets.size() ||
+            !erase(outOffsets, outTargets, from, to)) {
+            return false;
+        }
+        erase(inOffsets, inSources, to, from);
+        if (++deadEdges > max<size_t>(1024, outTargets.size() / 4)) {
+            compact();
+        }
+        return true;
+    }
+
+    // Drops every edge into or out of v, so the slot can be reused
+    void removeNode(int v) {
+        if ((size_t)v + 1 < outOffsets.size()) {
+            for (int i = outOffsets[v]; i < outOffsets[v + 1]; ++i) {
+                if (outTargets[i] != -1) {
+                    erase(inOffsets, inSources, outTargets[i], v);
+                    outTargets[i] = -1;
+                    ++deadEdges;
+                }
+            }
+            for (int i = inOffsets[v]; i < inOffsets[v + 1]; ++i) {
+                if (inSources[i] != -1) {
+                    erase(outOffsets, outTargets, inSources[i], v);
+                    inSources[i] = -1;
+                    ++deadEdges;
+                }
+            }
+        }
+        dropDelta(deltaOut, deltaIn, v);
+        dropDelta(deltaIn, deltaOut, v);
+        if (deadEdges > max<size_t>(1024, outTargets.size() / 4)) {
+            compact();
+        }
+    }
+
+    template <typename F>
+    void forEachSuccessor(int v, F f) const {
+        visit(outOffsets, outTargets, deltaOut, v, f);
+    }
+
+    template <typename F>
+    void forEachPredecessor(int v, F f) const {
+        visit(inOffsets, inSources, deltaIn, v, f);
+    }
+
+    // Merges the delta into the CSR arrays and drops tombstones
+    void compact() {
+        if (deltaEdges == 0 && deadEdges == 0 && outOffsets.size() == nodes + 1) {
+            return;
+        }
+        vector<pair<int, int>> edges;
+        edges.reserve(edgeCount());
+        for (size_t v = 0; v < nodes; ++v) {
+            forEachSuccessor(v, [&](int w) { edges.emplace_back(v, w); });
+        }
+        build(edges, nodes);
+    }
+
+private:
+    size_t nodes = 0;
+    vector<int> outOffsets{0}, outTargets;
+    vector<int> inOffsets{0}, inSources;
+    unordered_map<int, vector<int>> deltaOut, deltaIn;
+    size_t deltaEdges = 0;
+    size_t deadEdges = 0;
+
+    void fillCsr(const vector<pair<int, int>>& edges, vector<int>& offsets, vector<int>& targets, bool reverse) {
+        offsets.assign(nodes + 1, 0);
+        for (const auto& edge : edges) {
+            ++offsets[(reverse ? edge.second : edge.first) + 1];
+        }
+        for (size_t v = 0; v < nodes; ++v) {
+            offsets[v + 1] += offsets[v];
+        }
+        targets.assign(edges.size(), -1);
+        vector<int> cursor(offsets.begin(), offsets.end() - 1);
+        for (const auto& edge : edges) {
+            int key = reverse ? edge.second : edge.first;
+            targets[cursor[key]++] = reverse ? edge.first : edge.second;
+        }
+    }
+
+    template <typename F>
+    static void visit(const vector<int>& offsets, const vector<int>& targets,
+                      const unordered_map<int, vector<int>>& delta, int v, F& f) {
+        if ((size_t)v + 1 < offsets.size()) {
+            for (int i = offsets[v]; i < offsets[v + 1]; ++i) {
+                if (targets[i] != -1) {
+                    f(targets[i]);
+                }
+            }
+        }
+        if (!delta.empty()) {
+            auto it = delta.find(v);
+            if (it != delta.end()) {
+                for (int w : it->second) {
+                    f(w);
+                }
+            }
+        }
+    }
+
+    static bool erase(const vector<int>& offsets, vector<int>& targets, int v, int value) {
+        for (int i = offsets[v]; i < offsets[v + 1]; ++i) {
+            if (targets[i] == value) {
+                targets[i] = -1;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void dropDelta(unordered_map<int, vector<int>>& side, unordered_map<int, vector<int>>& other, int v) {
+        auto it = side.find(v);
+        if (it == side.end()) {
+            return;
+        }
+        for (int w : it->second) {
+            auto back = other.find(w);
+            if (back != other.end()) {
+                auto& list = back->second;
+                list.erase(std::remove(list.begin(), list.end(), v), list.end());
+                if (list.empty()) {
+                    other.erase(back);
+                }
+            }
+        }
+        deltaEdges -= it->second.size();
+        side.erase(it);
+    }
+};
+
+#endif // EDGESTORE_H
@@ -0,0 +1,172 @@
+#ifndef EPOCH_H
+#define EPOCH_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+// A pointer to an immutable T that one writer replaces and any number of
+// readers follow without locks (RCU style). Readers announce the epoch
+// they entered in a slot of their own; the writer swaps the pointer,
+// stamps the old object with the epoch and frees it once no reader is
+// still in that epoch or an earlier one.
+//
+// Every atomic uses the default sequentially consistent order: a reader
+// that announced an epoch after the swap is guaranteed to load the new
+// pointer, and the writer's scan of the slots cannot miss a reader that
+// still holds the old one.
+template <typename T>
+class EpochPtr {
+    struct alignas(64) ReaderSlot {
+        atomic<uint64_t> epoch{0}; // 0 while outside a read
+        atomic<bool> claimed{false};
+    };
+
+public:
+    // A reader's claim on one slot; one per reading thread
+    class Reader {
+    public:
+        // Pins the current object for as long as the guard lives
+        class Guard {
+        public:
+            explicit Guard(ReaderSlot& slot, const atomic<uint64_t>& epoch, const atomic<const T*>& current)
+                : slot(&slot) {
+                slot.epoch.store(epoch.load());
+                object = current.load();
+            }
+
+            Guard(Guard&& other) : slot(other.slot), object(other.object) {
+                other.slot = nullptr;
+            }
+
+            Guard(const Guard&) = delete;
+            Guard& operator=(const Guard&) = delete;
+
+            ~Guard() {
+                if (slot != nullptr) {
+                    slot->epoch.store(0);
+                }
+            }
+
+            const T& operator*() const {
+                return *object;
+            }
+
+            const T* operator->() const {
+                return object;
+            }
+
+            const T* get() const {
+                return object;
+            }
+
+        private:
+            ReaderSlot* slot;
+            const T* object;
+        };
+
+        Reader(Reader&& other) : owner(other.owner), slot(other.slot) {
+            other.slot = nullptr;
+        }
+
+        Reader(const Reader&) = delete;
+        Reader& operator=(const Reader&) = delete;
+
+        ~Reader() {
+            if (slot != nullptr) {
+                slot->epoch.store(0);
+                slot->claimed.store(false);
+            }
+        }
+
+        // Guards do not nest; take one per read
+        Guard pin() const {
+            return Guard(*slot, owner->epoch, owner->current);
+        }
+
+    private:
+        friend class EpochPtr;
+        Reader(const EpochPtr* owner, ReaderSlot* slot) : owner(owner), slot(slot) {}
+
+        const EpochPtr* owner;
+        ReaderSlot* slot;
+    };
+
+    explicit EpochPtr(size_t maxReaders = 256) : slots(maxReaders) {}
+
+    ~EpochPtr() {
+        delete current.load();
+        for (auto& entry : retired) {
+            delete entry.second;
+        }
+    }
+
+    EpochPtr(const EpochPtr&) = delete;
+    EpochPtr& operator=(const EpochPtr&) = delete;
+
+    // Claims a free reader slot; throws when all are taken
+    Reader reader() const {
+        for (ReaderSlot& slot : slots) {
+            bool expected = false;
+            if (!slot.claimed.load() && slot.claimed.compare_exchange_strong(expected, true)) {
+                return Reader(this, &slot);
+            }
+        }
+        throw runtime_error("Too many snapshot readers");
+    }
+
+    // Writer only: makes object current, then frees whatever earlier
+    // objects no reader can still see
+    void publish(unique_ptr<const T> object) {
+        const T* old = current.exchange(object.release());
+        if (old != nullptr) {
+            retired.emplace_back(epoch.fetch_add(1), old);
+        }
+        reclaim();
+    }
+
+    // Writer only: the object most recently published
+    const T* latest() const {
+        return current.load();
+    }
+
+    // Writer only: frees retired objects no reader can still see
+    void reclaim() {
+        uint64_t oldestActive = UINT64_MAX;
+        for (const ReaderSlot& slot : slots) {
+            uint64_t e = slot.epoch.load();
+            if (e != 0 && e < oldestActive) {
+                oldestActive = e;
+            }
+        }
+        size_t kept = 0;
+        for (auto& entry : retired) {
+            // Readers that entered after the entry's epoch loaded a newer
+            // pointer
+            if (entry.first < oldestActive) {
+                delete entry.second;
+            } else {
+                retired[kept++] = entry;
+            }
+        }
+        retired.resize(kept);
+    }
+
+    // Objects replaced but not yet freed
+    size_t retiredCount() const {
+        return retired.size();
+    }
+
+private:
+    atomic<const T*> current{nullptr};
+    atomic<uint64_t> epoch{1}; // Never 0, which marks an idle slot
+    mutable vector<ReaderSlot> slots;
+    vector<pair<uint64_t, const T*>> retired; // (epoch when replaced, object)
+};
+
+#endif // EPOCH_H
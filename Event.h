@@ -0,0 +1,331 @@
+#ifndef EVENT_H
+#define EVENT_H
+
+#include <algorithm>
+#include <climits>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <sstream>
+#include <cstdio>
+
+using namespace std;
+
+// How an event repeats: every `every` days from its own date, up to and
+// including the day `until` (days since epoch). every is 0 for a one-off
+// event. The rule is stored once; occurrences are only worked out for the
+// times a query asks about.
+struct Recurrence {
+    int every = 0;
+    int until = INT_MAX; // No end
+
+    bool repeats() const {
+        return every > 0;
+    }
+
+    // Minutes between occurrences
+    int period() const {
+        return every * 1440;
+    }
+
+    // The events file and journal field, "R:every" or "R:every:until date"
+    string field() const;
+
+    // Reads field(); false if field is not one
+    static bool parse(string_view field, Recurrence& recurrence);
+};
+
+class Event {
+public:
+    int id;
+    string name;
+    int start; // Minutes since 1970-01-01 00:00
+    int end;   // Same day as start, 24:00 at the latest; parsed once, compared as plain ints
+    Recurrence recurrence; // start and end are the first occurrence
+
+    Event(int id = 0, string name = "", string date = "", string startTime = "", string endTime = "")
+        : id(id), name(name), start(toMinutes(date, startTime)), end(toMinutes(date, endTime)) {}
+
+    // From times already in minutes
+    Event(int id, string name, int start, int end, Recurrence recurrence = Recurrence())
+        : id(id), name(move(name)), start(start), end(end), recurrence(recurrence) {}
+
+    bool operator<(const Event& other) const {
+        if (start != other.start) return start < other.start;
+        if (end != other.end) return end < other.end;
+        return id < other.id;
+    }
+
+    bool operator>(const Event& other) const {
+        return other < *this;
+    }
+
+    bool operator==(const Event& other) const {
+        return id == other.id;
+    }
+
+    bool operator!=(const Event& other) const {
+        return !(*this == other);
+    }
+
+    bool repeats() const {
+        return recurrence.repeats();
+    }
+
+    // Ids index dense per-id tables (id -> slot, id -> tree node), so they
+    // are kept to a range those tables can afford
+    static constexpr int MAX_ID = 1 << 24;
+
+    static bool isValidId(int id) {
+        return id > 0 && id <= MAX_ID;
+    }
+
+    // Number of occurrences; LLONG_MAX when the rule has no end
+    long long occurrences() const {
+        if (!repeats()) return 1;
+        if (recurrence.until == INT_MAX) return LLONG_MAX;
+        return recurrence.until < day() ? 1 : (recurrence.until - day()) / recurrence.every + 1;
+    }
+
+    // Occurrence k, counting from 0, as a one-off event
+    Event occurrence(long long k) const {
+        long long shift = k * recurrence.period();
+        return Event(id, name, (int)(start + shift), (int)(end + shift));
+    }
+
+    // End of the last occurrence, INT_MAX if there is none
+    int lastEnd() const {
+        long long count = occurrences();
+        if (count == LLONG_MAX) return INT_MAX;
+        return (int)min<long long>(end + (count - 1) * recurrence.period(), INT_MAX);
+    }
+
+    // The first occurrence overlapping [from, to), or -1 if none does; O(1)
+    long long occurrenceDuring(int from, int to) const {
+        long long k = 0;
+        if (end <= from) {
+            if (!repeats()) return -1;
+            k = ((long long)from - end) / recurrence.period() + 1;
+        }
+        if (k >= occurrences() || start + k * recurrence.period() >= to) return -1;
+        return k;
+    }
+
+    // Whether any occurrence of this overlaps any occurrence of other.
+    // Between two repeating events the pattern recurs once both run, after
+    // the lcm of their periods, so only one such cycle of the one with the
+    // longer period is walked.
+    bool overlaps(const Event& other) const {
+        if (!repeats() && !other.repeats()) return start < other.end && other.start < end;
+        if (!repeats()) return other.occurrenceDuring(start, end) != -1;
+        if (!other.repeats()) return occurrenceDuring(other.start, other.end) != -1;
+        const Event& a = recurrence.every >= other.recurrence.every ? *this : other;
+        const Event& b = &a == this ? other : *this;
+        long long pa = a.recurrence.period(), pb = b.recurrence.period();
+        long long cycle = pa / gcd(pa, pb) * pb;
+        long long limit = min<long long>((long long)max(a.start, b.start) + cycle + pb, b.lastEnd());
+        long long count = a.occurrences();
+        for (long long k = b.start < a.end ? 0 : (b.start - a.end) / pa + 1; k < count; ++k) {
+            long long s = a.start + k * pa;
+            if (s >= limit) break;
+            if (b.occurrenceDuring((int)s, (int)(s + a.end - a.start)) != -1) return true;
+        }
+        return false;
+    }
+
+    int day() const {
+        return floorDiv(start, 1440);
+    }
+
+    // Text forms are only produced for display and file I/O
+    string date() const {
+        return formatDate(day());
+    }
+
+    string startTime() const {
+        return formatTime(start - day() * 1440);
+    }
+
+    string endTime() const {
+        return formatTime(end - day() * 1440);
+    }
+
+    void setDate(const string& newDate) {
+        int shift = (parseDate(newDate) - day()) * 1440;
+        start += shift;
+        end += shift;
+    }
+
+    void setStartTime(const string& newStartTime) {
+        start = day() * 1440 + parseTime(newStartTime);
+    }
+
+    void setEndTime(const string& newEndTime) {
+        end = day() * 1440 + parseTime(newEndTime);
+    }
+
+    static long long gcd(long long a, long long b) {
+        while (b != 0) {
+            long long r = a % b;
+            a = b;
+            b = r;
+        }
+        return a;
+    }
+
+    static int floorDiv(int a, int b) {
+        return a / b - (a % b != 0 && (a < 0) != (b < 0));
+    }
+
+    // Days since 1970-01-01 for a "YYYY-MM-DD" date (civil calendar)
+    static int parseDate(string_view date) {
+        if (date.size() < 10) return 0;
+        int y = digits(date, 0, 4), m = digits(date, 5, 2), d = digits(date, 8, 2);
+        y -= m <= 2;
+        int era = floorDiv(y, 400);
+        int yoe = y - era * 400;
+        int doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+        int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+        return era * 146097 + doe - 719468;
+    }
+
+    // Years whose minutes since 1970, and the distance between any two of
+    // them, still fit in an int
+    static constexpr int MIN_YEAR = 1900;
+    static constexpr int MAX_YEAR = 4000;
+
+    static int daysInMonth(int y, int m) {
+        static const int days[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+        bool leap = (y % 4 == 0 && y % 100 != 0) || y % 400 == 0;
+        return m == 2 && leap ? 29 : days[m - 1];
+    }
+
+    static bool isValidDate(string_view date) {
+        if (!(date.size() == 10 && isDigits(date, 0, 4) && date[4] == '-' &&
+              isDigits(date, 5, 2) && date[7] == '-' && isDigits(date, 8, 2))) {
+            return false;
+        }
+        int y = digits(date, 0, 4), m = digits(date, 5, 2), d = digits(date, 8, 2);
+        return y >= MIN_YEAR && y <= MAX_YEAR && m >= 1 && m <= 12 && d >= 1 && d <= daysInMonth(y, m);
+    }
+
+    static bool isValidTime(string_view time) {
+        if (!(time.size() == 5 && isDigits(time, 0, 2) && time[2] == ':' && isDigits(time, 3, 2))) {
+            return false;
+        }
+        return digits(time, 0, 2) < 24 && digits(time, 3, 2) < 60;
+    }
+
+    // An event may run up to midnight but not past it
+    static bool isValidEndTime(string_view time) {
+        return time == "24:00" || isValidTime(time);
+    }
+
+    // Minutes since midnight for an "HH:MM" time
+    static int parseTime(string_view time) {
+        if (time.size() < 5) return 0;
+        return digits(time, 0, 2) * 60 + digits(time, 3, 2);
+    }
+
+    static int toMinutes(string_view date, string_view time) {
+        return parseDate(date) * 1440 + parseTime(time);
+    }
+
+    static string formatDate(int days) {
+        days += 719468;
+        int era = floorDiv(days, 146097);
+        int doe = days - era * 146097;
+        int yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+        int doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+        int mp = (5 * doy + 2) / 153;
+        int d = doy - (153 * mp + 2) / 5 + 1;
+        int m = mp < 10 ? mp + 3 : mp - 9;
+        int y = yoe + era * 400 + (m <= 2);
+        char buf[32];
+        snprintf(buf, sizeof(buf), "%04d-%02d-%02d", y, m, d);
+        return buf;
+    }
+
+    static string formatTime(int minutes) {
+        char buf[32];
+        snprintf(buf, sizeof(buf), "%02d:%02d", minutes / 60, minutes % 60);
+        return buf;
+    }
+
+    friend ostream& operator<<(ostream& os, const Event& event);
+    friend istream& operator>>(istream& is, Event& event);
+
+private:
+    static bool isDigits(string_view s, size_t pos, size_t len) {
+        for (size_t i = pos; i < pos + len; ++i) {
+            if (s[i] < '0' || s[i] > '9') return false;
+        }
+        return true;
+    }
+
+    static int digits(string_view s, size_t pos, size_t len) {
+        int value = 0;
+        for (size_t i = pos; i < pos + len; ++i) {
+            value = value * 10 + (s[i] - '0');
+        }
+        return value;
+    }
+};
+
+inline string Recurrence::field() const {
+    string text = "R:" + to_string(every);
+    if (until != INT_MAX) {
+        text += ":" + Event::formatDate(until);
+    }
+    return text;
+}
+
+inline bool Recurrence::parse(string_view field, Recurrence& recurrence) {
+    if (field.size() < 3 || field.substr(0, 2) != "R:") {
+        return false;
+    }
+    field.remove_prefix(2);
+    size_t colon = field.find(':');
+    string_view every = field.substr(0, colon);
+    if (every.empty() || every.size() > 5 || every.find_first_not_of("0123456789") != string_view::npos) {
+        return false;
+    }
+    Recurrence parsed;
+    for (char c : every) {
+        parsed.every = parsed.every * 10 + (c - '0');
+    }
+    if (colon != string_view::npos) {
+        string_view until = field.substr(colon + 1);
+        if (!Event::isValidDate(until)) {
+            return false;
+        }
+        parsed.until = Event::parseDate(until);
+    }
+    recurrence = parsed;
+    return true;
+}
+
+inline ostream& operator<<(ostream& os, const Event& event) {
+    os << event.id << "," << event.name << "," << event.date() << "," << event.startTime() << "," << event.endTime();
+        return os;
+}
+
+inline istream& operator>>(istream& is, Event& event) {
+    string line;
+        if (getline(is, line)) {
+            stringstream ss(line);
+            string token, date, startTime, endTime;
+            getline(ss, token, ',');
+            event.id = stoi(token);
+            getline(ss, event.name, ',');
+            getline(ss, date, ',');
+            getline(ss, startTime, ',');
+            getline(ss, endTime, ',');
+            event.start = Event::toMinutes(date, startTime);
+            event.end = Event::toMinutes(date, endTime);
+        }
+        return is;
+}
+
+#endif // EVENT_H
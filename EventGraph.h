@@ -0,0 +1,839 @@
+#ifndef EVENTGRAPH_H
+#define EVENTGRAPH_H
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <chrono>
+#include <iterator>
+#include "AVLTree.h"
+#include "EdgeStore.h"
+#include "EventStore.h"
+#include "Export.h"
+#include "Csv.h"
+
+using namespace std;
+
+struct LoadStats {
+    size_t events = 0;
+    size_t edges = 0;
+    size_t bytes = 0;
+    double seconds = 0;
+    int maxId = 0; // Highest event id in the file
+    size_t skipped = 0; // Lines with a bad id, date, time, span or repeat rule, left out
+
+    double eventsPerSecond() const {
+        return seconds > 0 ? events / seconds : 0;
+    }
+};
+
+// Scheduling analytics for one event, in minutes since epoch
+struct EventTiming {
+    int id = 0;
+    int earliestStart = 0; // Once every prerequisite has finished
+    int latestStart = 0;   // Without pushing a dependent past its scheduled end
+    int slack = 0;         // latestStart - earliestStart; negative when violated
+};
+
+class EventGraph {
+private:
+    // The events themselves, by slot; everything below is indexed by slot
+    EventStore ownStore;
+    EventStore* store; // &ownStore unless shared
+    EdgeStore edges; // The only copy of the dependency edges, between slots
+
+    // Topological order kept online (Pearce-Kelly): for every edge u -> v,
+    // ord[u] < ord[v]. slotAtOrd maps positions back to slots, with -1 for
+    // positions left behind by deleted events.
+    vector<int> ord;
+    vector<int> slotAtOrd;
+    int orderHoles = 0;
+
+    // Scratch for the bounded searches in addDependency and for Kahn's
+    // algorithm, kept across calls so traversals do not allocate
+    vector<char> mark;
+    vector<int> forwardSet, backwardSet, searchStack, positions;
+    mutable vector<int> indegreeScratch, queueScratch;
+
+    // Critical-path analytics. For each slot: the earliest start given the
+    // prerequisites' earliest finishes (own start for events without
+    // prerequisites), the latest finish given the dependents' latest
+    // starts (own end for events without dependents), and where the
+    // longest chain ending here begins. Mutations only record the slots
+    // whose values may have moved; the next query pushes those changes
+    // along the topological order until values settle, so a burst of
+    // edits is settled in one pass over just the events it affects.
+    mutable vector<int> earliest, latestFinish, chainStart;
+    mutable vector<int> dirtyEarliest, dirtyLatest;
+    mutable vector<char> queued;
+    mutable vector<int> timingQueue;
+    vector<int> violatedIn; // Incoming edges whose source ends after this event starts
+
+    int slotOf(int id) const {
+        return store->slotOf(id);
+    }
+
+    // Date, start and end of slot as text, straight from the columns
+    template <typename Out>
+    void writeWhen(Out& out, int slot, const char* dateSep, const char* timeSep) const {
+        int day = Event::floorDiv(store->start(slot), 1440);
+        out << Event::formatDate(day) << dateSep << Event::formatTime(store->start(slot) - day * 1440)
+            << timeSep << Event::formatTime(store->end(slot) - day * 1440);
+    }
+
+    // Live slots scope covers: in its date range and, given ids, reachable
+    // from one of them against the edges or along them
+    vector<char> coveredSlots(const ExportScope& scope) const {
+        size_t n = store->slots();
+        vector<char> covered(n, 0);
+        if (scope.ids.empty()) {
+            for (size_t slot = 0; slot < n; ++slot) {
+                covered[slot] = store->isLive(slot) && scope.inRange(store->start(slot));
+            }
+            return covered;
+        }
+        vector<int> seeds;
+        for (int id : scope.ids) {
+            int slot = slotOf(id);
+            if (slot == -1) {
+                throw runtime_error("Event not found");
+            }
+            seeds.push_back(slot);
+        }
+        // Prerequisites and dependents are walked apart, so an event's
+        // other dependents do not come in through a shared prerequisite
+        auto reach = [&](auto forEachNext) {
+            vector<char> seen(n, 0);
+            vector<int> stack = seeds;
+            for (int slot : seeds) {
+                seen[slot] = 1;
+            }
+            while (!stack.empty()) {
+                int slot = stack.back();
+                stack.pop_back();
+                covered[slot] = 1;
+                forEachNext(slot, [&](int next) {
+                    if (!seen[next]) {
+                        seen[next] = 1;
+                        stack.push_back(next);
+                    }
+                });
+            }
+        };
+        reach([this](int slot, auto push) { edges.forEachPredecessor(slot, push); });
+        reach([this](int slot, auto push) { edges.forEachSuccessor(slot, push); });
+        for (size_t slot = 0; slot < n; ++slot) {
+            covered[slot] = covered[slot] && scope.inRange(store->start(slot));
+        }
+        return covered;
+    }
+
+    // Applies edit to a copy of slot's times and stores the result
+    template <typename Edit>
+    void editTimes(int id, Edit edit) {
+        int slot = slotOf(id);
+        if (slot == -1) {
+            return;
+        }
+        Event times(id);
+        times.start = store->start(slot);
+        times.end = store->end(slot);
+        edit(times);
+        store->setTimes(slot, times.start, times.end);
+        timesChanged(slot);
+    }
+
+    // Per-slot arrays follow the store's slot count
+    void growSlots() {
+        size_t n = store->slots();
+        if (ord.size() >= n) {
+            return;
+        }
+        edges.resize(n);
+        ord.resize(n, -1);
+        mark.resize(n, false);
+        earliest.resize(n, 0);
+        latestFinish.resize(n, 0);
+        chainStart.resize(n, 0);
+        violatedIn.resize(n, 0);
+        queued.resize(n, false);
+    }
+
+    // Forward search from v over events ordered no later than ub; reaching
+    // the edge source means the new edge would close a cycle. Uses an
+    // explicit stack so long chains cannot overflow the call stack.
+    bool searchForward(int v, int ub) {
+        mark[v] = true;
+        forwardSet.push_back(v);
+        searchStack.assign(1, v);
+        bool cycle = false;
+        while (!searchStack.empty() && !cycle) {
+            int x = searchStack.back();
+            searchStack.pop_back();
+            edges.forEachSuccessor(x, [&](int w) {
+                if (ord[w] == ub) {
+                    cycle = true;
+                } else if (!mark[w] && ord[w] < ub) {
+                    mark[w] = true;
+                    forwardSet.push_back(w);
+                    searchStack.push_back(w);
+                }
+            });
+        }
+        return cycle;
+    }
+
+    void searchBackward(int v, int lb) {
+        mark[v] = true;
+        backwardSet.push_back(v);
+        searchStack.assign(1, v);
+        while (!searchStack.empty()) {
+            int x = searchStack.back();
+            searchStack.pop_back();
+            edges.forEachPredecessor(x, [&](int w) {
+                if (!mark[w] && ord[w] > lb) {
+                    mark[w] = true;
+                    backwardSet.push_back(w);
+                    searchStack.push_back(w);
+                }
+            });
+        }
+    }
+
+    // Moves everything that reaches the edge source ahead of everything
+    // reachable from its target, reusing only the positions they held.
+    void reorder() {
+        auto byOrd = [this](int a, int b) { return ord[a] < ord[b]; };
+        sort(backwardSet.begin(), backwardSet.end(), byOrd);
+        sort(forwardSet.begin(), forwardSet.end(), byOrd);
+
+        positions.clear();
+        for (int v : backwardSet) positions.push_back(ord[v]);
+        for (int v : forwardSet) positions.push_back(ord[v]);
+        sort(positions.begin(), positions.end());
+
+        size_t i = 0;
+        for (int v : backwardSet) {
+            ord[v] = positions[i++];
+            slotAtOrd[ord[v]] = v;
+        }
+        for (int v : forwardSet) {
+            ord[v] = positions[i++];
+            slotAtOrd[ord[v]] = v;
+        }
+    }
+
+    void clearMarks() {
+        for (int v : forwardSet) mark[v] = false;
+        for (int v : backwardSet) mark[v] = false;
+        forwardSet.clear();
+        backwardSet.clear();
+    }
+
+    // Kahn's algorithm over the whole graph into queueScratch; returns false
+    // if some events are left on a cycle
+    bool kahn() const {
+        indegreeScratch.assign(store->slots(), 0);
+        queueScratch.clear();
+        queueScratch.reserve(store->slots());
+        for (size_t slot = 0; slot < store->slots(); ++slot) {
+            if (!store->isLive(slot)) {
+                continue;
+            }
+            indegreeScratch[slot] = edges.inDegree(slot);
+            if (indegreeScratch[slot] == 0) {
+                queueScratch.push_back(slot);
+            }
+        }
+        for (size_t head = 0; head < queueScratch.size(); ++head) {
+            edges.forEachSuccessor(queueScratch[head], [&](int w) {
+                if (--indegreeScratch[w] == 0) {
+                    queueScratch.push_back(w);
+                }
+            });
+        }
+        return queueScratch.size() == store->size();
+    }
+
+    // Rebuilds ord/slotAtOrd from scratch; false if the graph has a cycle
+    bool rebuildOrder() {
+        if (!kahn()) {
+            return false;
+        }
+        slotAtOrd = queueScratch;
+        for (size_t i = 0; i < slotAtOrd.size(); ++i) {
+            ord[slotAtOrd[i]] = i;
+        }
+        orderHoles = 0;
+        return true;
+    }
+
+    int duration(int slot) const {
+        return store->end(slot) - store->start(slot);
+    }
+
+    int earliestFinish(int slot) const {
+        return earliest[slot] + duration(slot);
+    }
+
+    // Recomputes slot's earliest start and chain start from its
+    // prerequisites; true if either changed
+    bool computeEarliest(int slot) const {
+        int start = store->start(slot);
+        int chain = store->start(slot);
+        bool first = true;
+        edges.forEachPredecessor(slot, [&](int p) {
+            int finish = earliestFinish(p);
+            if (first || finish > start || (finish == start && chainStart[p] < chain)) {
+                start = finish;
+                chain = chainStart[p];
+                first = false;
+            }
+        });
+        bool changed = start != earliest[slot] || chain != chainStart[slot];
+        earliest[slot] = start;
+        chainStart[slot] = chain;
+        return changed;
+    }
+
+    bool computeLatest(int slot) const {
+        int finish = store->end(slot);
+        bool first = true;
+        edges.forEachSuccessor(slot, [&](int s) {
+            int latest = latestFinish[s] - duration(s);
+            if (first || latest < finish) {
+                finish = latest;
+                first = false;
+            }
+        });
+        bool changed = finish != latestFinish[slot];
+        latestFinish[slot] = finish;
+        return changed;
+    }
+
+    // Re-evaluates the seeds, then their dependents in topological order
+    // for as long as values keep changing. Seeds always pass the change on,
+    // since their own duration may be what changed.
+    void propagateEarliest(const vector<int>& seeds) const {
+        auto later = [this](int a, int b) { return ord[a] > ord[b]; };
+        propagate(seeds, later, [this](int slot) { return computeEarliest(slot); },
+                  [this](int slot, auto push) { edges.forEachSuccessor(slot, push); });
+    }
+
+    void propagateLatest(const vector<int>& seeds) const {
+        auto earlier = [this](int a, int b) { return ord[a] < ord[b]; };
+        propagate(seeds, earlier, [this](int slot) { return computeLatest(slot); },
+                  [this](int slot, auto push) { edges.forEachPredecessor(slot, push); });
+    }
+
+    template <typename Compare, typename Compute, typename Next>
+    void propagate(const vector<int>& seeds, Compare compare, Compute compute, Next next) const {
+        timingQueue.clear();
+        auto push = [&](int slot) {
+            if (!queued[slot]) {
+                queued[slot] = true;
+                timingQueue.push_back(slot);
+                push_heap(timingQueue.begin(), timingQueue.end(), compare);
+            }
+        };
+        for (int slot : seeds) {
+            if (store->isLive(slot)) {
+                push(slot);
+                queued[slot] = 2;
+            }
+        }
+        while (!timingQueue.empty()) {
+            pop_heap(timingQueue.begin(), timingQueue.end(), compare);
+            int slot = timingQueue.back();
+            timingQueue.pop_back();
+            bool seed = queued[slot] == 2;
+            queued[slot] = false;
+            if (compute(slot) || seed) {
+                next(slot, push);
+            }
+        }
+    }
+
+    bool violates(int from, int to) const {
+        return store->end(from) > store->start(to);
+    }
+
+    void countViolations(int slot) {
+        violatedIn[slot] = 0;
+        edges.forEachPredecessor(slot, [&](int p) { violatedIn[slot] += violates(p, slot); });
+    }
+
+    // An event's times changed: recheck its edges now, settle the timing
+    // values on the next query
+    void timesChanged(int slot) {
+        countViolations(slot);
+        edges.forEachSuccessor(slot, [&](int s) { countViolations(s); });
+        dirtyEarliest.push_back(slot);
+        dirtyLatest.push_back(slot);
+    }
+
+    void settleTimings() const {
+        if (dirtyEarliest.empty() && dirtyLatest.empty()) {
+            return;
+        }
+        // Past a point one plain pass over everything is cheaper than the
+        // ordered queue
+        if (dirtyEarliest.size() + dirtyLatest.size() > store->size() / 4) {
+            recomputeTimings();
+        } else {
+            propagateEarliest(dirtyEarliest);
+            propagateLatest(dirtyLatest);
+        }
+        dirtyEarliest.clear();
+        dirtyLatest.clear();
+    }
+
+    // One linear pass each way over the whole order
+    void recomputeTimings() const {
+        for (int slot : slotAtOrd) {
+            if (slot != -1) {
+                computeEarliest(slot);
+            }
+        }
+        for (auto it = slotAtOrd.rbegin(); it != slotAtOrd.rend(); ++it) {
+            if (*it != -1) {
+                computeLatest(*it);
+            }
+        }
+    }
+
+    void compactOrder() {
+        size_t next = 0;
+        for (int slot : slotAtOrd) {
+            if (slot != -1) {
+                ord[slot] = next;
+                slotAtOrd[next++] = slot;
+            }
+        }
+        slotAtOrd.resize(next);
+        orderHoles = 0;
+    }
+
+public:
+    EventGraph() : store(&ownStore) {}
+
+    // A graph over a store shared with other indexes. The graph adds and
+    // drops the events; the others only keep handles to them.
+    explicit EventGraph(EventStore& shared) : store(&shared) {}
+
+    EventGraph(const EventGraph&) = delete;
+    EventGraph& operator=(const EventGraph&) = delete;
+
+    void addEvent(const Event& event) {
+        int slot = store->add(event);
+        growSlots();
+        if (ord[slot] != -1) {
+            // Same id again: the fields are refreshed, the edges kept
+            timesChanged(slot);
+            return;
+        }
+        ord[slot] = slotAtOrd.size();
+        slotAtOrd.push_back(slot);
+        earliest[slot] = chainStart[slot] = event.start;
+        latestFinish[slot] = event.end;
+    }
+
+    // addDependency never lets a cycle in, but files edited by hand can
+    // still be checked; iterative, so chain length does not matter
+    bool hasCycle() const {
+        return !kahn();
+    }
+
+    // Only the events ordered between the two endpoints are searched, and
+    // only when the new edge contradicts the current order.
+    void addDependency(int fromEventId, int toEventId) {
+        int fromIndex = slotOf(fromEventId);
+        int toIndex = slotOf(toEventId);
+        if (fromIndex == -1 || toIndex == -1) {
+            return;
+        }
+        if (fromIndex == toIndex) {
+            throw runtime_error("Adding this dependency creates a cycle");
+        }
+        if (edges.hasEdge(fromIndex, toIndex)) {
+            return;
+        }
+        if (ord[toIndex] < ord[fromIndex]) {
+            bool cycle = searchForward(toIndex, ord[fromIndex]);
+            if (cycle) {
+                clearMarks();
+                throw runtime_error("Adding this dependency creates a cycle");
+            }
+            searchBackward(fromIndex, ord[toIndex]);
+            reorder();
+            clearMarks();
+        }
+        edges.addEdge(fromIndex, toIndex);
+        violatedIn[toIndex] += violates(fromIndex, toIndex);
+        dirtyEarliest.push_back(toIndex);
+        dirtyLatest.push_back(fromIndex);
+    }
+
+    bool hasDependency(int fromEventId, int toEventId) const {
+        int fromIndex = slotOf(fromEventId);
+        int toIndex = slotOf(toEventId);
+        return fromIndex != -1 && toIndex != -1 && edges.hasEdge(fromIndex, toIndex);
+    }
+
+    // Dropping an edge never invalidates the order, so only the timings
+    // on either side are revisited
+    void removeDependency(int fromEventId, int toEventId) {
+        int fromIndex = slotOf(fromEventId);
+        int toIndex = slotOf(toEventId);
+        if (fromIndex == -1 || toIndex == -1 || !edges.removeEdge(fromIndex, toIndex)) {
+            return;
+        }
+        violatedIn[toIndex] -= violates(fromIndex, toIndex);
+        dirtyEarliest.push_back(toIndex);
+        dirtyLatest.push_back(fromIndex);
+    }
+
+    // Every dependency into or out of the event, as (from id, to id)
+    vector<pair<int, int>> dependenciesOf(int id) const {
+        vector<pair<int, int>> found;
+        int slot = slotOf(id);
+        if (slot != -1) {
+            edges.forEachPredecessor(slot, [&](int p) { found.emplace_back(store->id(p), id); });
+            edges.forEachSuccessor(slot, [&](int s) { found.emplace_back(id, store->id(s)); });
+        }
+        return found;
+    }
+
+    void updateEventName(int id, const string& newName) {
+        int slot = slotOf(id);
+        if (slot != -1) {
+            store->setName(slot, newName);
+        }
+    }
+
+    void updateEventDate(int id, const string& newDate) {
+        editTimes(id, [&](Event& event) { event.setDate(newDate); });
+    }
+
+    void updateEventStartTime(int id, const string& newStartTime) {
+        editTimes(id, [&](Event& event) { event.setStartTime(newStartTime); });
+    }
+
+    void updateEventEndTime(int id, const string& newEndTime) {
+        editTimes(id, [&](Event& event) { event.setEndTime(newEndTime); });
+    }
+
+    // Dependencies are timed by the first occurrence, which this leaves as is
+    void updateEventRecurrence(int id, const Recurrence& recurrence) {
+        int slot = slotOf(id);
+        if (slot != -1) {
+            store->setRecurrence(slot, recurrence);
+        }
+    }
+
+    void deleteEvent(int id) {
+        int slot = slotOf(id);
+        if (slot == -1) {
+            return;
+        }
+        edges.forEachPredecessor(slot, [&](int p) { dirtyLatest.push_back(p); });
+        edges.forEachSuccessor(slot, [&](int s) {
+            dirtyEarliest.push_back(s);
+            violatedIn[s] -= violates(slot, s);
+        });
+        edges.removeNode(slot);
+        violatedIn[slot] = 0;
+        slotAtOrd[ord[slot]] = -1;
+        ord[slot] = -1;
+        if (++orderHoles > (int)slotAtOrd.size() / 2) {
+            compactOrder();
+        }
+        store->remove(id);
+    }
+
+    void clearEvents() {
+        store->clear();
+        edges.clear();
+        ord.clear();
+        slotAtOrd.clear();
+        orderHoles = 0;
+        mark.clear();
+        earliest.clear();
+        latestFinish.clear();
+        chainStart.clear();
+        violatedIn.clear();
+        queued.clear();
+        dirtyEarliest.clear();
+        dirtyLatest.clear();
+    }
+
+    Event findEventById(int id) const {
+        int slot = slotOf(id);
+        if (slot == -1) {
+            throw runtime_error("Event not found");
+        }
+        return store->event(slot);
+    }
+
+    // Topological sort: the order is maintained by addDependency, so this is
+    // a single walk over it
+    vector<Event> topologicalSort() {
+        vector<Event> sortedEvents;
+        sortedEvents.reserve(slotAtOrd.size() - orderHoles);
+        for (int slot : slotAtOrd) {
+            if (slot != -1) {
+                sortedEvents.push_back(store->event(slot));
+            }
+        }
+        return sortedEvents;
+    }
+
+    EventTiming timing(int id) const {
+        int slot = slotOf(id);
+        if (slot == -1) {
+            throw runtime_error("Event not found");
+        }
+        settleTimings();
+        EventTiming result;
+        result.id = id;
+        result.earliestStart = earliest[slot];
+        result.latestStart = latestFinish[slot] - duration(slot);
+        result.slack = result.latestStart - result.earliestStart;
+        return result;
+    }
+
+    // The longest chain of dependent events by elapsed time, from the start
+    // of its first event to the earliest finish of its last
+    vector<Event> criticalPath() const {
+        settleTimings();
+        int last = -1;
+        for (size_t slot = 0; slot < store->slots(); ++slot) {
+            if (store->isLive(slot) && (last == -1 || earliestFinish(slot) - chainStart[slot] > earliestFinish(last) - chainStart[last])) {
+                last = slot;
+            }
+        }
+        vector<Event> path;
+        for (int slot = last; slot != -1;) {
+            path.push_back(store->event(slot));
+            int tight = -1;
+            edges.forEachPredecessor(slot, [&](int p) {
+                if (tight == -1 && earliestFinish(p) == earliest[slot] && chainStart[p] == chainStart[slot]) {
+                    tight = p;
+                }
+            });
+            slot = tight;
+        }
+        reverse(path.begin(), path.end());
+        return path;
+    }
+
+    // Dependencies whose prerequisite currently ends after the dependent
+    // event starts, as (from id, to id)
+    vector<pair<int, int>> violatedDependencies() const {
+        vector<pair<int, int>> result;
+        for (size_t slot = 0; slot < store->slots(); ++slot) {
+            if (store->isLive(slot) && violatedIn[slot] > 0) {
+                edges.forEachPredecessor(slot, [&](int p) {
+                    if (violates(p, slot)) {
+                        result.emplace_back(store->id(p), store->id(slot));
+                    }
+                });
+            }
+        }
+        sort(result.begin(), result.end());
+        return result;
+    }
+
+    // Bulk load: the file is read once, events and edges are built in a
+    // single pass, the tree is built from sorted input in linear time and
+    // acyclicity is checked once at the end with Kahn's algorithm.
+    LoadStats loadEvents(const string& filename, AVLTree& avlTree) {
+        LoadStats stats;
+        auto startClock = chrono::steady_clock::now();
+
+        ifstream infile(filename, ios::binary);
+        if (!infile.is_open()) {
+            return stats;
+        }
+        string buffer((istreambuf_iterator<char>(infile)), istreambuf_iterator<char>());
+        stats.bytes = buffer.size();
+
+        clearEvents();
+        // A tree over this graph's store only needs handles, so no copies of
+        // the events are collected for it
+        bool sharedTree = avlTree.usesStore(*store);
+        avlTree.clear();
+        // One event per line
+        store->reserve(count(buffer.begin(), buffer.end(), '\n') + 1);
+        vector<Event> sorted;
+        vector<pair<int, int>> idEdges; // (from id, to id)
+        int maxId = 0;
+
+        string_view rest(buffer);
+        while (!rest.empty()) {
+            size_t eol = rest.find('\n');
+            string_view line = rest.substr(0, eol);
+            rest.remove_prefix(eol == string_view::npos ? rest.size() : eol + 1);
+            if (!line.empty() && line.back() == '\r') {
+                line.remove_suffix(1);
+            }
+            if (line.empty()) {
+                continue;
+            }
+
+            string_view idField = nextCsvField(line);
+            string_view nameField = nextCsvField(line);
+            string_view dateField = nextCsvField(line);
+            string_view startField = nextCsvField(line);
+            string_view endField = nextCsvField(line);
+
+            Event event;
+            if (!parseCsvInt(idField, event.id) || !Event::isValidId(event.id) || !Event::isValidDate(dateField) ||
+                !Event::isValidTime(startField) || !Event::isValidEndTime(endField)) {
+                ++stats.skipped;
+                continue;
+            }
+            event.name.assign(nameField.data(), nameField.size());
+            event.start = Event::toMinutes(dateField, startField);
+            event.end = Event::toMinutes(dateField, endField);
+            if (event.end <= event.start ||
+                (!line.empty() && line[0] == 'R' && !Recurrence::parse(nextCsvField(line), event.recurrence))) {
+                ++stats.skipped;
+                continue;
+            }
+
+            while (!line.empty()) {
+                int depId;
+                if (parseCsvInt(nextCsvField(line), depId)) {
+                    idEdges.emplace_back(event.id, depId);
+                }
+            }
+
+            addEvent(event);
+            maxId = max(maxId, event.id);
+            if (!sharedTree) {
+                sorted.push_back(move(event));
+            }
+        }
+
+        vector<pair<int, int>> slotEdges;
+        slotEdges.reserve(idEdges.size());
+        for (const auto& edge : idEdges) {
+            int from = slotOf(edge.first);
+            int to = slotOf(edge.second);
+            if (from != -1 && to != -1) {
+                slotEdges.emplace_back(from, to);
+            }
+        }
+        edges.build(slotEdges, store->slots());
+        stats.edges = edges.edgeCount();
+
+        if (!rebuildOrder()) {
+            clearEvents();
+            throw runtime_error("Events file contains a dependency cycle");
+        }
+        recomputeTimings();
+        for (size_t slot = 0; slot < store->slots(); ++slot) {
+            if (store->isLive(slot)) {
+                countViolations(slot);
+            }
+        }
+
+        if (sharedTree) {
+            avlTree.buildFromStore();
+        } else {
+            if (!is_sorted(sorted.begin(), sorted.end())) {
+                sort(sorted.begin(), sorted.end());
+            }
+            avlTree.buildFromSorted(sorted);
+        }
+
+        stats.maxId = maxId;
+        stats.events = store->size();
+        stats.seconds = chrono::duration<double>(chrono::steady_clock::now() - startClock).count();
+        return stats;
+    }
+
+    // Streams the graph, or the part of it scope covers, and returns the
+    // number of events written. Only edges between covered events appear.
+    // DOT and CSV list each event's dependents (CSV rows are events.txt
+    // lines); JSON maps each event id to its prerequisites' ids, all as
+    // strings so the Python viewer sees one node per event.
+    size_t exportTo(ExportWriter& out, ExportFormat format, const ExportScope& scope = ExportScope()) const {
+        vector<char> covered = coveredSlots(scope);
+        size_t written = 0;
+        if (format == ExportFormat::Dot) {
+            out << "digraph EventGraph {\n";
+        } else if (format == ExportFormat::Json) {
+            out << '{';
+        }
+        for (size_t slot = 0; slot < store->slots(); ++slot) {
+            if (!covered[slot]) {
+                continue;
+            }
+            switch (format) {
+            case ExportFormat::Dot:
+                out << store->id(slot) << " [label=\"";
+                out.quoted(store->name(slot)) << "\\n";
+                writeWhen(out, slot, "\\n", "-");
+                out << "\"];\n";
+                break;
+            case ExportFormat::Json: {
+                out << (written == 0 ? "\n\"" : ",\n\"") << store->id(slot) << "\":[";
+                bool first = true;
+                edges.forEachPredecessor(slot, [&](int p) {
+                    if (covered[p]) {
+                        out << (first ? "\"" : ",\"") << store->id(p) << '"';
+                        first = false;
+                    }
+                });
+                out << ']';
+                break;
+            }
+            case ExportFormat::Csv:
+                out << store->id(slot) << ',' << store->name(slot) << ',';
+                writeWhen(out, slot, ",", ",");
+                if (store->repeats(slot)) {
+                    out << ',' << store->recurrence(slot).field();
+                }
+                edges.forEachSuccessor(slot, [&](int dep) {
+                    if (covered[dep]) {
+                        out << ',' << store->id(dep);
+                    }
+                });
+                out << '\n';
+                break;
+            }
+            ++written;
+        }
+        if (format == ExportFormat::Dot) {
+            for (size_t slot = 0; slot < store->slots(); ++slot) {
+                if (!covered[slot]) {
+                    continue;
+                }
+                edges.forEachSuccessor(slot, [&](int dep) {
+                    if (covered[dep]) {
+                        out << store->id(slot) << " -> " << store->id(dep) << ";\n";
+                    }
+                });
+            }
+            out << "}\n";
+        } else if (format == ExportFormat::Json) {
+            out << "\n}\n";
+        }
+        return written;
+    }
+
+    // Writes the events file; throws if it cannot be written in full
+    void saveEvents(const string& filename) const {
+        ExportWriter out(filename);
+        exportTo(out, ExportFormat::Csv);
+        out.close();
+    }
+};
+
+#endif // EVENTGRAPH_H
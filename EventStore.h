@@ -0,0 +1,207 @@
+#ifndef EVENTSTORE_H
+#define EVENTSTORE_H
+
+#include <climits>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "Event.h"
+#include "StringPool.h"
+
+using namespace std;
+
+// The one owning copy of every event. Events live in slots; a deleted
+// event leaves a tombstone whose slot is reused by the next add, so slots
+// of live events never move and serve as handles for the indexes built
+// on top (the time-ordered AVLTree, the dependency EventGraph).
+//
+// Fields are kept column by column (ids, starts, ends, interned names),
+// so scans over times read two packed int arrays. Event is only
+// materialised at the edges, by event(slot). Recurrence rules are rare, so
+// they sit in a side table keyed by slot instead of a column.
+class EventStore {
+public:
+    // Stores event under its id and returns its slot. An id already
+    // present keeps its slot and has its fields replaced. Throws on an id
+    // outside Event::isValidId.
+    int add(const Event& event) {
+        if (!Event::isValidId(event.id)) {
+            throw runtime_error("Invalid event id " + to_string(event.id));
+        }
+        int slot = slotOf(event.id);
+        if (slot != -1) {
+            setName(slot, event.name);
+            setTimes(slot, event.start, event.end);
+            setRecurrence(slot, event.recurrence);
+            return slot;
+        }
+        if (!freeSlots.empty()) {
+            slot = freeSlots.back();
+            freeSlots.pop_back();
+        } else {
+            slot = ids.size();
+            ids.push_back(0);
+            starts.push_back(0);
+            ends.push_back(0);
+            names.push_back(-1);
+        }
+        if (event.id >= (int)slotOfId.size()) {
+            slotOfId.resize(event.id + 1, -1);
+        }
+        slotOfId[event.id] = slot;
+        ids[slot] = event.id;
+        starts[slot] = event.start;
+        ends[slot] = event.end;
+        names[slot] = strings.intern(event.name);
+        setRecurrence(slot, event.recurrence);
+        return slot;
+    }
+
+    // Room for count more events
+    void reserve(size_t count) {
+        ids.reserve(ids.size() + count);
+        starts.reserve(starts.size() + count);
+        ends.reserve(ends.size() + count);
+        names.reserve(names.size() + count);
+        strings.reserve(count);
+    }
+
+    void remove(int id) {
+        int slot = slotOf(id);
+        if (slot == -1) {
+            return;
+        }
+        strings.release(names[slot]);
+        names[slot] = -1;
+        // An empty span at the far past overlaps nothing, so time scans
+        // need no liveness test
+        starts[slot] = ends[slot] = INT_MIN;
+        rules.erase(slot);
+        freeSlots.push_back(slot);
+        slotOfId[id] = -1;
+    }
+
+    void clear() {
+        ids.clear();
+        starts.clear();
+        ends.clear();
+        names.clear();
+        freeSlots.clear();
+        slotOfId.clear();
+        strings.clear();
+        rules.clear();
+    }
+
+    // Slot of the event with this id, -1 when absent
+    int slotOf(int id) const {
+        if (id < 0 || id >= (int)slotOfId.size()) {
+            return -1;
+        }
+        return slotOfId[id];
+    }
+
+    bool isLive(int slot) const {
+        return names[slot] != -1;
+    }
+
+    int id(int slot) const {
+        return ids[slot];
+    }
+
+    int start(int slot) const {
+        return starts[slot];
+    }
+
+    int end(int slot) const {
+        return ends[slot];
+    }
+
+    // Valid until the next change to the store
+    string_view name(int slot) const {
+        return strings.view(names[slot]);
+    }
+
+    Event event(int slot) const {
+        return Event(ids[slot], string(name(slot)), starts[slot], ends[slot], recurrence(slot));
+    }
+
+    // The event without its name, for working out when it occurs
+    Event times(int slot) const {
+        return Event(ids[slot], string(), starts[slot], ends[slot], recurrence(slot));
+    }
+
+    bool repeats(int slot) const {
+        return !rules.empty() && rules.count(slot) != 0;
+    }
+
+    Recurrence recurrence(int slot) const {
+        if (rules.empty()) {
+            return Recurrence();
+        }
+        auto it = rules.find(slot);
+        return it == rules.end() ? Recurrence() : it->second;
+    }
+
+    // A one-off rule drops the slot from the table
+    void setRecurrence(int slot, const Recurrence& recurrence) {
+        if (recurrence.repeats()) {
+            rules[slot] = recurrence;
+        } else if (!rules.empty()) {
+            rules.erase(slot);
+        }
+    }
+
+    // Slot -> rule of every repeating event
+    const unordered_map<int, Recurrence>& recurrences() const {
+        return rules;
+    }
+
+    // Callers must re-key the indexes over the store afterwards
+    void setTimes(int slot, int start, int end) {
+        starts[slot] = start;
+        ends[slot] = end;
+    }
+
+    void setName(int slot, string_view name) {
+        int old = names[slot];
+        names[slot] = strings.intern(name);
+        strings.release(old);
+    }
+
+    // Whole columns, indexed by slot; dead slots hold INT_MIN times
+    const vector<int>& startColumn() const {
+        return starts;
+    }
+
+    const vector<int>& endColumn() const {
+        return ends;
+    }
+
+    // Number of slots, live or not; per-slot side arrays are sized to this
+    size_t slots() const {
+        return ids.size();
+    }
+
+    size_t size() const {
+        return ids.size() - freeSlots.size();
+    }
+
+    // Distinct names in use
+    size_t distinctNames() const {
+        return strings.size();
+    }
+
+private:
+    vector<int> ids;
+    vector<int> starts;
+    vector<int> ends;
+    vector<int> names; // Interned name ids, -1 for dead slots
+    vector<int> freeSlots;
+    vector<int> slotOfId; // Event id -> slot, -1 when absent
+    StringPool strings;
+    unordered_map<int, Recurrence> rules; // Slot -> rule, repeating events only
+};
+
+#endif // EVENTSTORE_H
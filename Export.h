@@ -0,0 +1,165 @@
+#ifndef EXPORT_H
+#define EXPORT_H
+
+#include <cerrno>
+#include <charconv>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace std;
+
+// Output formats shared by the graph and tree exporters:
+//   Dot   Graphviz input
+//   Json  what visualize_event_graph.py and visualize_avl_tree.py read
+//   Csv   one row per event
+enum class ExportFormat { Dot, Json, Csv };
+
+// "dot", "json" or "csv"; throws on anything else
+inline ExportFormat parseExportFormat(string_view name) {
+    if (name == "dot") return ExportFormat::Dot;
+    if (name == "json") return ExportFormat::Json;
+    if (name == "csv") return ExportFormat::Csv;
+    throw runtime_error("Unknown export format, expected dot, json or csv");
+}
+
+// Which events an export covers: those starting in [from, to), minutes
+// since epoch, and if ids is not empty only those ids plus every event
+// they depend on or that depends on them. Tree exports use the range only.
+struct ExportScope {
+    int from = INT_MIN;
+    int to = INT_MAX;
+    vector<int> ids;
+
+    bool inRange(int start) const {
+        return start >= from && start < to;
+    }
+};
+
+// Streams an export to a file through one fixed 1 MB buffer, handed to
+// the kernel a whole buffer at a time. Failures throw runtime_error;
+// close() reports the last write, which the destructor cannot.
+class ExportWriter {
+public:
+    explicit ExportWriter(const string& path) : path(path), buffer(new char[CAPACITY]) {
+        fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd == -1) {
+            throw runtime_error("Cannot write " + path + ": " + strerror(errno));
+        }
+    }
+
+    ~ExportWriter() {
+        if (fd != -1) {
+            try {
+                flush();
+            } catch (const runtime_error&) {
+                // Callers wanting the error call close()
+            }
+            ::close(fd);
+        }
+    }
+
+    ExportWriter(const ExportWriter&) = delete;
+    ExportWriter& operator=(const ExportWriter&) = delete;
+
+    ExportWriter& operator<<(string_view s) {
+        if (used + s.size() > CAPACITY) {
+            flush();
+            if (s.size() > CAPACITY) {
+                writeAll(s.data(), s.size());
+                return *this;
+            }
+        }
+        memcpy(buffer.get() + used, s.data(), s.size());
+        used += s.size();
+        return *this;
+    }
+
+    ExportWriter& operator<<(const char* s) {
+        return *this << string_view(s);
+    }
+
+    ExportWriter& operator<<(const string& s) {
+        return *this << string_view(s);
+    }
+
+    ExportWriter& operator<<(char c) {
+        if (used == CAPACITY) {
+            flush();
+        }
+        buffer[used++] = c;
+        return *this;
+    }
+
+    ExportWriter& operator<<(int value) {
+        char digits[16];
+        char* end = to_chars(digits, digits + sizeof(digits), value).ptr;
+        return *this << string_view(digits, end - digits);
+    }
+
+    // s as the inside of a double-quoted DOT or JSON string
+    ExportWriter& quoted(string_view s) {
+        size_t plain = 0;
+        for (size_t i = 0; i < s.size(); ++i) {
+            unsigned char c = s[i];
+            if (c != '"' && c != '\\' && c >= 0x20) {
+                continue;
+            }
+            *this << s.substr(plain, i - plain);
+            plain = i + 1;
+            if (c == '"' || c == '\\') {
+                *this << '\\' << (char)c;
+            } else {
+                // Control characters: events.txt never holds them, but a
+                // stray one must not break the output
+                char escape[8];
+                snprintf(escape, sizeof(escape), "\\u%04x", c);
+                *this << escape;
+            }
+        }
+        return *this << s.substr(plain);
+    }
+
+    void flush() {
+        writeAll(buffer.get(), used);
+        used = 0;
+    }
+
+    void close() {
+        flush();
+        int closing = fd;
+        fd = -1;
+        if (::close(closing) == -1) {
+            throw runtime_error("Cannot write " + path + ": " + strerror(errno));
+        }
+    }
+
+private:
+    static constexpr size_t CAPACITY = 1 << 20;
+
+    string path;
+    int fd = -1;
+    unique_ptr<char[]> buffer;
+    size_t used = 0;
+
+    void writeAll(const char* data, size_t size) {
+        while (size > 0) {
+            ssize_t put = ::write(fd, data, size);
+            if (put == -1) {
+                if (errno == EINTR) continue;
+                throw runtime_error("Cannot write " + path + ": " + strerror(errno));
+            }
+            data += put;
+            size -= put;
+        }
+    }
+};
+
+#endif // EXPORT_H
@@ -4,307 +4,19 @@
 #include <ncurses.h>
 #include <vector>
 #include <algorithm>
-#include <set>
 #include <stdexcept>
-#include <unordered_map>
-#include <stack>
-#include <sstream>
-#include <regex>
+#include <chrono>
+#include <iterator>
+#include <csignal>
 #include "AVLTree.h"
+#include "EventGraph.h"
+#include "Scheduler.h"
+#include "Batch.h"
+#include "Render.h"
+#include "Server.h"
 
 using namespace std;
 
-int e_id = 1; // Global event ID counter
-
-class EventGraph {
-private:
-    vector<Event> events;
-    vector<vector<int>> dependencies;
-
-public:
-    void addEvent(const Event& event) {
-        events.push_back(event);
-        dependencies.push_back({});
-    }
-
-    bool hasCycleUtil(int v, unordered_map<int, bool>& visited, unordered_map<int, bool>& recStack) const {
-        if (!visited[v]) {
-            visited[v] = true;
-            recStack[v] = true;
-
-            for (int dep : findEventById(v).dependencies) {
-                if (!visited[dep] && hasCycleUtil(dep, visited, recStack)) {
-                    return true;
-                } else if (recStack[dep]) {
-                    return true;
-                }
-            }
-        }
-        recStack[v] = false;
-        return false;
-    }
-
-    bool hasCycle() const {
-        unordered_map<int, bool> visited;
-        unordered_map<int, bool> recStack;
-        for (const auto& event : events) {
-            if (hasCycleUtil(event.id, visited, recStack)) {
-                return true;
-            }
-        }
-        return false;
-    }
-
-    void addDependency(int fromEventId, int toEventId) {
-        int fromIndex = -1, toIndex = -1;
-        for (size_t i = 0; i < events.size(); ++i) {
-            if (events[i].id == fromEventId) fromIndex = i;
-            if (events[i].id == toEventId) toIndex = i;
-        }
-        if (fromIndex != -1 && toIndex != -1) {
-            dependencies[fromIndex].push_back(toEventId);
-            events[fromIndex].dependencies.insert(toEventId);
-            if (hasCycle()) {
-                dependencies[fromIndex].pop_back();
-                events[fromIndex].dependencies.erase(toEventId);
-                throw runtime_error("Adding this dependency creates a cycle");
-            }
-        }
-    }
-
-    void updateEventName(int id, const string& newName) {
-        for (auto& event : events) {
-            if (event.id == id) {
-                event.name = newName;
-                break;
-            }
-        }
-    }
-
-    void updateEventDate(int id, const string& newDate) {
-        for (auto& event : events) {
-            if (event.id == id) {
-                event.date = newDate;
-                break;
-            }
-        }
-    }
-
-    void updateEventStartTime(int id, const string& newStartTime) {
-        for (auto& event : events) {
-            if (event.id == id) {
-                event.startTime = newStartTime;
-                break;
-            }
-        }
-    }
-
-    void updateEventEndTime(int id, const string& newEndTime) {
-        for (auto& event : events) {
-            if (event.id == id) {
-                event.endTime = newEndTime;
-                break;
-            }
-        }
-    }
-
-    void deleteEvent(int id) {
-        events.erase(remove_if(events.begin(), events.end(), [id](const Event& event) {
-            return event.id == id;
-        }), events.end());
-    }
-    
-    Event findEventById(int id) const {
-    for (const auto& event : events) {
-        if (event.id == id) {
-            return event;
-        }
-    }
-    throw runtime_error("Event not found");
-}
-
-void topologicalSortUtil(int v, unordered_map<int, bool>& visited, stack<int>& Stack) {
-    // Mark the current node as visited
-    visited[v] = true;
-
-    // Recur for all the vertices adjacent to this vertex
-    for (int dep : findEventById(v).dependencies) {
-        if (!visited[dep]) {
-            topologicalSortUtil(dep, visited, Stack);
-        }
-    }
-
-    // Push current vertex to stack which stores the result
-    Stack.push(v);
-}
-
-// Topological sort function
-vector<Event> topologicalSort() {
-    stack<int> Stack;
-    unordered_map<int, bool> visited;
-    vector<Event> sortedEvents;
-
-    // Mark all the vertices as not visited
-    for (const auto& event : events) {
-        visited[event.id] = false;
-    }
-
-    // Call the recursive helper function to store Topological Sort starting from all vertices one by one
-    for (const auto& event : events) {
-        if (!visited[event.id]) {
-            topologicalSortUtil(event.id, visited, Stack);
-        }
-    }
-
-    // Pop all vertices from stack and add to the sorted list
-    while (!Stack.empty()) {
-        sortedEvents.push_back(findEventById(Stack.top()));
-        Stack.pop();
-    }
-
-    return sortedEvents;
-}
-
-    void exportGraph(const string& filename) const {
-        ofstream outfile(filename);
-        outfile << "digraph EventGraph {\n";
-        outfile << "node [fontname=\"Arial\"];\n";
-
-        for (const auto& event : events) {
-            outfile << "\"" << event.name << "\" [label=\"" << event.name << "\\n" << event.date << "\\n" << event.startTime << "-" << event.endTime << "\"];\n";
-        }
-
-        outfile << "}\n";
-    }
-
-    void viewSchedule() const {
-        clear();
-        mvprintw(0, 0, "Event Schedule:");
-        int row = 1;
-        for (const auto& event : events) {
-            mvprintw(row++, 0, "%d: %s (%s %s-%s)", event.id, event.name.c_str(), event.date.c_str(), event.startTime.c_str(), event.endTime.c_str());
-        }
-        refresh();
-        mvprintw(row, 0, "Press any key to return to the main menu...");
-        getch();
-    }
-
-    bool hasConflict(const Event& newEvent) const {
-    for (const auto& event : events) {
-        if (newEvent.date == event.date && 
-            !(newEvent.endTime <= event.startTime || newEvent.startTime >= event.endTime)) {
-            return true;
-        }
-    }
-    return false;
-}
-
-
-    void loadEvents(const string& filename, AVLTree& avlTree) {
-    ifstream infile(filename);
-    if (!infile.is_open()) {
-        return;
-    }
-
-    events.clear();
-    dependencies.clear();
-    string line;
-    int maxId = 0;
-
-    // First pass to load all events
-    while (getline(infile, line)) {
-        stringstream ss(line);
-        string token;
-        Event event;
-
-        getline(ss, token, ',');
-        event.id = stoi(token);
-        getline(ss, token, ',');
-        event.name = token;
-        getline(ss, token, ',');
-        event.date = token;
-        getline(ss, token, ',');
-        event.startTime = token;
-        getline(ss, token, ',');
-        event.endTime = token;
-
-        events.push_back(event);
-        dependencies.push_back({}); // Initialize empty dependencies for each event
-
-        avlTree.insert(event); // Insert event into AVL tree
-
-        if (event.id > maxId) {
-            maxId = event.id;
-        }
-    }
-
-    e_id = maxId + 1; // Initialize e_id to one more than the highest ID
-
-    // Second pass to add dependencies
-    infile.clear();
-    infile.seekg(0, ios::beg);
-
-    while (getline(infile, line)) {
-        stringstream ss(line);
-        string token;
-        getline(ss, token, ',');
-        int eventId = stoi(token);
-
-        // Skip event details
-        for (int i = 0; i < 5; ++i) {
-            getline(ss, token, ',');
-        }
-
-        while (getline(ss, token, ',')) {
-            int depId = stoi(token);
-            addDependency(eventId, depId); // Add dependency for the event
-        }
-    }
-}
-
-
-    void visualize_event_graph() const {
-    clear();
-    ofstream outfile("eventgraph.dot");
-    if (!outfile) {
-        cerr << "Error creating dot file" << endl;
-        return;
-    }
-    outfile << "digraph EventGraph {\n";
-    for (const auto& event : events) {
-        outfile << event.id << " [label=\"" << event.name << "\\n" << event.date << "\\n" << event.startTime << "-" << event.endTime << "\"];\n";
-    }
-    for (size_t i = 0; i < events.size(); ++i) {
-        for (int dep : dependencies[i]) {
-            outfile << events[i].id << " -> " << dep << ";\n";
-        }
-    }
-    outfile << "}\n";
-    outfile.close();
-    system("dot -Tpng eventgraph.dot -o eventgraph.png");
-    system("xdg-open eventgraph.png");
-    mvprintw(2, 0, "Event graph exported and visualized");
-    mvprintw(4, 0, "Press any key to return to the main menu...");
-    refresh();
-    getch();
-}
-
-
-    void saveEvents(const string& filename) const {
-    ofstream outfile(filename);
-    for (const auto& event : events) {
-        outfile << event.id << "," << event.name << "," << event.date << "," 
-                << event.startTime << "," << event.endTime;
-        for (int dep : event.dependencies) {
-            outfile << "," << dep;
-        }
-        outfile << endl;
-    }
-}
-
-
-};
-
 // Initialize Ncurses
 void initialize_ncurses() {
     initscr();
@@ -336,7 +48,7 @@ void draw_box(int starty, int startx, int height, int width, int color_pair) {
 }
 
 // Display Menu with enhanced UI
-void display_menu() {
+void display_menu(const string& status = "") {
     clear();
     int starty = (LINES - 15) / 2;
     int startx = (COLS - 50) / 2;
@@ -356,22 +68,105 @@ void display_menu() {
     mvprintw(starty + 10, startx + 5, "8. Topological Sort"); // New option for topological sort
     mvprintw(starty + 11, startx + 5, "9. Search Event");
     mvprintw(starty + 12, startx + 5, "10. Exit");
+    if (!status.empty()) {
+        mvprintw(LINES - 1, 0, "%s", status.c_str());
+    }
     mvprintw(starty + 14, startx + 5, "Enter your choice: "); // Adjusted for the new option
 
     refresh();
 }
 
 bool validate_date(const string& date) {
-    regex date_pattern("^\\d{4}-\\d{2}-\\d{2}$");
-    return regex_match(date, date_pattern);
+    return Event::isValidDate(date);
 }
 
 bool validate_time(const string& time) {
-    regex time_pattern("^\\d{2}:\\d{2}$");
-    return regex_match(time, time_pattern);
+    return Event::isValidTime(time);
+}
+
+bool validate_end_time(const string& time) {
+    return Event::isValidEndTime(time);
+}
+
+// Time-ordered schedule, optionally limited to a date range, shown one
+// screen at a time. Pages are found by rank in the tree, so jumping to
+// any page costs O(log n) and only that page is walked.
+void view_schedule(const Scheduler& scheduler) {
+    clear();
+    mvprintw(0, 0, "From date (YYYY-MM-DD, empty for all): ");
+    char from_cstr[20];
+    getstr(from_cstr);
+    mvprintw(1, 0, "To date, inclusive (YYYY-MM-DD, empty for all): ");
+    char to_cstr[20];
+    getstr(to_cstr);
+    string from(from_cstr), to(to_cstr);
+
+    int fromMinute = validate_date(from) ? Event::parseDate(from) * 1440 : INT_MIN;
+    int toMinute = validate_date(to) ? (Event::parseDate(to) + 1) * 1440 : INT_MAX;
+
+    size_t pageSize = max(1, LINES - 3);
+    size_t total = scheduler.countBetween(fromMinute, toMinute);
+    size_t pages = max<size_t>(1, (total + pageSize - 1) / pageSize);
+    size_t page = 0;
+    while (true) {
+        clear();
+        mvprintw(0, 0, "Event Schedule (page %zu of %zu, %zu events):", page + 1, pages, total);
+        int row = 1;
+        for (const Event& event : scheduler.eventsPage(fromMinute, toMinute, page, pageSize)) {
+            mvprintw(row++, 0, "%d: %s (%s %s-%s)%s", event.id, event.name.c_str(), event.date().c_str(), event.startTime().c_str(), event.endTime().c_str(),
+                     event.repeats() ? (" every " + to_string(event.recurrence.every) + " days").c_str() : "");
+        }
+        mvprintw(LINES - 1, 0, "n: next page  p: previous page  g: go to page  any other key: main menu");
+        refresh();
+        int key = getch();
+        if (key == 'n') {
+            if (page + 1 < pages) ++page;
+        } else if (key == 'p') {
+            if (page > 0) --page;
+        } else if (key == 'g') {
+            mvprintw(LINES - 1, 0, "Go to page (1-%zu): ", pages);
+            clrtoeol();
+            size_t target;
+            if (scanw("%zu", &target) == 1 && target >= 1 && target <= pages) {
+                page = target - 1;
+            }
+        } else {
+            break;
+        }
+    }
 }
 
-void create_event(EventGraph& graph, AVLTree& avlTree) {
+// Writes the DOT file and the JSON file the matching Python viewer reads,
+// then hands rendering to the background worker
+template <typename Export>
+void visualize(RenderWorker& renderer, const string& name, const string& jsonFile, Export exportTo) {
+    clear();
+    try {
+        ExportWriter json(jsonFile);
+        exportTo(json, ExportFormat::Json);
+        json.close();
+        // The DOT file belongs to the render job, so exporting again while
+        // it runs writes a new one instead of rewriting the one dot reads
+        string dotPath = RenderWorker::tempDot(name);
+        try {
+            ExportWriter dot(dotPath);
+            exportTo(dot, ExportFormat::Dot);
+            dot.close();
+        } catch (const runtime_error&) {
+            unlink(dotPath.c_str());
+            throw;
+        }
+        renderer.render(dotPath, name + ".png");
+        mvprintw(2, 0, "Exported %s; rendering %s.png in the background", jsonFile.c_str(), name.c_str());
+    } catch (const runtime_error& e) {
+        mvprintw(2, 0, "Error: %s", e.what());
+    }
+    mvprintw(4, 0, "Press any key to return to the main menu...");
+    refresh();
+    getch();
+}
+
+void create_event(Scheduler& scheduler) {
     clear();
     mvprintw(0, 0, "Enter event name: ");
     char name[100];
@@ -403,31 +198,52 @@ void create_event(EventGraph& graph, AVLTree& avlTree) {
         char endTime_cstr[10];
         getstr(endTime_cstr);
         endTime = string(endTime_cstr);
-        if (validate_time(endTime)) break;
+        if (validate_end_time(endTime)) break;
         mvprintw(6, 0, "Invalid time format. Please enter again.");
     }
 
-    Event newEvent(e_id, name, date, startTime, endTime);
-
-    if (graph.hasConflict(newEvent)) {
-        mvprintw(8, 0, "Error: Event conflicts with existing events.");
-        refresh();
-        getch();
-        return;
+    Recurrence recurrence;
+    mvprintw(7, 0, "Repeat every how many days (0 for never): ");
+    scanw("%d", &recurrence.every);
+    if (recurrence.every > 0) {
+        while (true) {
+            mvprintw(8, 0, "Repeat until (YYYY-MM-DD, empty for no end): ");
+            char until_cstr[20];
+            getstr(until_cstr);
+            string until(until_cstr);
+            if (until.empty()) break;
+            if (validate_date(until)) {
+                recurrence.until = Event::parseDate(until);
+                break;
+            }
+            mvprintw(9, 0, "Invalid date format. Please enter again.");
+        }
     }
 
-    graph.addEvent(newEvent);
-    avlTree.insert(newEvent);
-    e_id++;
-
-    mvprintw(8, 0, "Event created successfully.");
-    mvprintw(10, 0, "Your Event-id is: %d", e_id - 1);
-    mvprintw(12, 0, "Press any key to return to the main menu...");
+    try {
+        int id = scheduler.createEvent(name, date, startTime, endTime, recurrence);
+        scheduler.publish();
+        mvprintw(10, 0, "Event created successfully.");
+        mvprintw(12, 0, "Your Event-id is: %d", id);
+    } catch (const runtime_error& e) {
+        mvprintw(10, 0, "Error: %s.", e.what());
+        // Offer the earliest time the same length would fit instead
+        Event wanted(-1, name, date, startTime, endTime);
+        if (wanted.end > wanted.start && !scheduler.conflictsWith(wanted).empty()) {
+            try {
+                int slot = scheduler.freeSlot(wanted.start, wanted.end - wanted.start);
+                Event free(-1, "", slot, slot + wanted.end - wanted.start);
+                mvprintw(12, 0, "Earliest free slot: %s %s-%s", free.date().c_str(), free.startTime().c_str(), free.endTime().c_str());
+            } catch (const runtime_error&) {
+            }
+        }
+    }
+    mvprintw(14, 0, "Press any key to return to the main menu...");
     refresh();
     getch();
 }
 
-void update_event(EventGraph& graph) {
+void update_event(Scheduler& scheduler) {
     clear();
     mvprintw(0, 0, "Enter event ID to update: ");
     int id;
@@ -463,42 +279,68 @@ void update_event(EventGraph& graph) {
         char endTime_cstr[10];
         getstr(endTime_cstr);
         endTime = string(endTime_cstr);
-        if (endTime.empty() || validate_time(endTime)) break;
+        if (endTime.empty() || validate_end_time(endTime)) break;
         mvprintw(7, 0, "Invalid time format. Please enter again.");
     }
 
-    if (strlen(name) > 0) {
-        graph.updateEventName(id, name);
-    }
-    if (!date.empty()) {
-        graph.updateEventDate(id, date);
-    }
-    if (!startTime.empty()) {
-        graph.updateEventStartTime(id, startTime);
-    }
-    if (!endTime.empty()) {
-        graph.updateEventEndTime(id, endTime);
+    optional<Recurrence> recurrence;
+    while (true) {
+        mvprintw(8, 0, "Repeat every how many days (0 for never) (leave empty to keep current): ");
+        char every_cstr[20];
+        getstr(every_cstr);
+        string every(every_cstr);
+        if (every.empty()) break;
+        Recurrence rule;
+        if (parseCsvInt(every, rule.every) && rule.every >= 0) {
+            recurrence = rule;
+            break;
+        }
+        mvprintw(9, 0, "Invalid number of days. Please enter again.");
+    }
+    if (recurrence && recurrence->every > 0) {
+        while (true) {
+            mvprintw(10, 0, "Repeat until (YYYY-MM-DD, empty for no end): ");
+            char until_cstr[20];
+            getstr(until_cstr);
+            string until(until_cstr);
+            if (until.empty()) break;
+            if (validate_date(until)) {
+                recurrence->until = Event::parseDate(until);
+                break;
+            }
+            mvprintw(11, 0, "Invalid date format. Please enter again.");
+        }
     }
 
-    mvprintw(9, 0, "Event updated successfully.");
-    mvprintw(11, 0, "Press any key to return to the main menu...");
+    try {
+        scheduler.updateEvent(id, name, date, startTime, endTime, recurrence);
+        scheduler.publish();
+        mvprintw(13, 0, "Event updated successfully.");
+    } catch (const runtime_error& e) {
+        mvprintw(13, 0, "Error: %s", e.what());
+    }
+    mvprintw(15, 0, "Press any key to return to the main menu...");
     refresh();
     getch();
 }
 
-void delete_event(EventGraph& graph, AVLTree& avlTree) {
+void delete_event(Scheduler& scheduler) {
     clear();
     mvprintw(0, 0, "Enter event ID to delete: ");
     int id;
     scanw("%d", &id);
-    graph.deleteEvent(id);
-    avlTree.remove(id);
-    mvprintw(2, 0, "Event deleted successfully.");
+    try {
+        scheduler.deleteEvent(id);
+        scheduler.publish();
+        mvprintw(2, 0, "Event deleted successfully.");
+    } catch (const runtime_error& e) {
+        mvprintw(2, 0, "Error: %s", e.what());
+    }
     refresh();
     getch();
 }
 
-void add_dependency(EventGraph& graph) {
+void add_dependency(Scheduler& scheduler) {
     clear();
     mvprintw(0, 0, "Enter the ID of the event to depend on: ");
     int fromEventId;
@@ -508,7 +350,8 @@ void add_dependency(EventGraph& graph) {
     int toEventId;
     scanw("%d", &toEventId);
 
-    graph.addDependency(fromEventId, toEventId);
+    scheduler.addDependency(fromEventId, toEventId);
+    scheduler.publish();
 
     mvprintw(3, 0, "Dependency added successfully.");
     mvprintw(5, 0, "Press any key to return to the main menu...");
@@ -516,45 +359,168 @@ void add_dependency(EventGraph& graph) {
     getch();
 }
 
-int main() {
-    initialize_ncurses();
+// Saves and closes; false, with the reason on stderr, if the changes could
+// not be made durable
+bool close_scheduler(Scheduler& scheduler) {
+    try {
+        scheduler.close();
+        return true;
+    } catch (const runtime_error& e) {
+        cerr << "Error saving: " << e.what() << endl;
+        return false;
+    }
+}
+
+// Without a terminal: runs the command stream from a file or stdin and
+// writes results to stdout
+int run_batch(Scheduler& scheduler, const string& input) {
+    ifstream infile;
+    if (input != "-") {
+        infile.open(input);
+        if (!infile) {
+            cerr << "Cannot open " << input << endl;
+            return 1;
+        }
+    }
+    istream& in = input == "-" ? cin : infile;
+    ios::sync_with_stdio(false);
+    auto start = chrono::steady_clock::now();
+    BatchStats stats = runBatch(scheduler, in, cout);
+    scheduler.publish();
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cerr << stats.commands << " commands, " << stats.errors << " errors in " << seconds << " s" << endl;
+    if (!close_scheduler(scheduler)) {
+        return 1;
+    }
+    return stats.errors == 0 ? 0 : 2;
+}
 
-    EventGraph graph;
-    AVLTree avlTree;
+Server* active_server = nullptr;
 
+void stop_server(int) {
+    if (active_server) {
+        active_server->stop();
+    }
+}
+
+// As a local service: the batch commands over a Unix domain socket until
+// SIGINT or SIGTERM
+int run_server(Scheduler& scheduler, const string& socketPath) {
+    Server server(scheduler, socketPath);
+    try {
+        server.listen();
+    } catch (const runtime_error& e) {
+        cerr << e.what() << endl;
+        return 1;
+    }
+    active_server = &server;
+    signal(SIGINT, stop_server);
+    signal(SIGTERM, stop_server);
+    cerr << "Listening on " << socketPath << endl;
+    ServerStats stats;
+    try {
+        stats = server.run();
+    } catch (const runtime_error& e) {
+        // Saving now writes the calendar as rolled back over the journal
+        active_server = nullptr;
+        cerr << "Server stopped: " << e.what() << endl;
+        close_scheduler(scheduler);
+        return 1;
+    }
+    active_server = nullptr;
+    cerr << stats.connections << " connections, " << stats.commands << " commands, " << stats.errors << " errors" << endl;
+    return close_scheduler(scheduler) ? 0 : 1;
+}
+
+void usage(const char* program) {
+    cerr << "usage: " << program << " [--events FILE] [--batch [FILE|-] | --serve SOCKET]" << endl;
+}
+
+int main(int argc, char** argv) {
     string events_filename = "events.txt";
-    graph.loadEvents(events_filename, avlTree); // Load events and insert into AVL tree
+    string batch_input;
+    string socket_path;
+    bool batch = false;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--events" && i + 1 < argc) {
+            events_filename = argv[++i];
+        } else if (arg == "--batch") {
+            batch = true;
+            batch_input = i + 1 < argc && string(argv[i + 1]).rfind("--", 0) != 0 ? argv[++i] : "-";
+        } else if (arg == "--serve" && i + 1 < argc) {
+            socket_path = argv[++i];
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    // Interactive edits are synced one by one; a batch is synced when it
+    // is folded into the events file at the end, and the server syncs once
+    // per loop pass
+    bool headless = batch || !socket_path.empty();
+    Scheduler scheduler(events_filename, headless ? 0 : 1);
+    LoadStats stats;
+    try {
+        stats = scheduler.open(); // Load events and replay the journal
+    } catch (const runtime_error& e) {
+        // Refuse to run on a bad snapshot: compaction would overwrite it
+        cerr << "Error loading " << events_filename << ": " << e.what() << endl;
+        return 1;
+    }
+    if (stats.skipped > 0) {
+        cerr << "Skipped " << stats.skipped << " malformed lines in " << events_filename << endl;
+    }
+
+    if (batch) {
+        return run_batch(scheduler, batch_input);
+    }
+    if (!socket_path.empty()) {
+        return run_server(scheduler, socket_path);
+    }
+
+    initialize_ncurses();
+    char buf[200];
+    snprintf(buf, sizeof(buf), "Loaded %zu events, %zu dependencies in %.3f s (%.0f events/s), replayed %zu journal records",
+             stats.events, stats.edges, stats.seconds, stats.eventsPerSecond(), scheduler.journalRecordsReplayed());
+    string status = buf;
+    if (stats.skipped > 0) {
+        status += ", skipped " + to_string(stats.skipped) + " bad lines";
+    }
+    RenderWorker renderer;
 
     int choice;
     while (true) {
-        display_menu();
+        // Once a render finishes, its outcome replaces the load summary
+        string rendered = renderer.lastResult();
+        display_menu(rendered.empty() ? status : rendered);
         scanw("%d", &choice);
 
         switch (choice) {
         case 1:
-            create_event(graph, avlTree);
-            graph.saveEvents(events_filename); // Save events after creating
+            create_event(scheduler);
             break;
         case 2:
-            update_event(graph);
-            graph.saveEvents(events_filename); // Save events after updating
+            update_event(scheduler);
             break;
         case 3:
-            delete_event(graph, avlTree);
-            graph.saveEvents(events_filename); // Save events after deleting
+            delete_event(scheduler);
             break;
         case 4:
-            graph.viewSchedule();
+            view_schedule(scheduler);
             break;
         case 5:
-            graph.visualize_event_graph();
+            visualize(renderer, "eventgraph", "event_data.json",
+                      [&](ExportWriter& out, ExportFormat format) { scheduler.getGraph().exportTo(out, format); });
             break;
         case 6:
-            avlTree.visualize(); // Implement this function in your AVLTree class
+            visualize(renderer, "avltree", "avl_tree_data.json",
+                      [&](ExportWriter& out, ExportFormat format) { scheduler.getTree().exportTo(out, format); });
             break;
         case 7:
             try{
-                add_dependency(graph);
+                add_dependency(scheduler);
             }catch (const runtime_error& e) {
                 mvprintw(2, 0, "Error: %s", e.what());
             }
@@ -565,7 +531,7 @@ int main() {
             clear();
             mvprintw(0, 0, "Events in topological order:");
             try {
-                vector<Event> sortedEvents = graph.topologicalSort();
+                vector<Event> sortedEvents = scheduler.topologicalSort();
                 int row = 1;
                 for (const auto& event : sortedEvents) {
                     mvprintw(row++, 0, "Event-id: %d", event.id);
@@ -585,8 +551,8 @@ int main() {
     scanw("%d", &t);
     try {
        Event event;
-       event = graph.findEventById(t);
-       mvprintw(2, 0, "Event-id: %d\nEvent name: %s\nDate:%s\nTiming: %s-%s", event.id, event.name.c_str(), event.date.c_str(), event.startTime.c_str(), event.endTime.c_str());
+       event = scheduler.findEvent(t);
+       mvprintw(2, 0, "Event-id: %d\nEvent name: %s\nDate:%s\nTiming: %s-%s", event.id, event.name.c_str(), event.date().c_str(), event.startTime().c_str(), event.endTime().c_str());
     } catch (const runtime_error& e) {
         mvprintw(3, 0, "Error: %s", e.what());
         mvprintw(5, 0, "Press any key to return to the main menu...");
@@ -602,7 +568,7 @@ int main() {
 
         case 10:
             endwin(); // End ncurses mode
-            return 0;
+            return close_scheduler(scheduler) ? 0 : 1;
         default:
             break;
         }
@@ -0,0 +1,281 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+#include "AVLTree.h"
+#include "Csv.h"
+
+using namespace std;
+
+// One journaled mutation. Records are CSV lines in the same field layout
+// as events.txt, prefixed with an op code:
+//   C,id,name,date,start,end[,R:...]   event created
+//   U,id,name,date,start,end[,R:...]   event updated (full new state)
+//   D,id                               event deleted
+//   E,from,to                          dependency added
+// Replaying a record twice leaves the same state, so a crash between a
+// snapshot and the journal truncation is harmless.
+struct JournalRecord {
+    char op = 0;
+    Event event;
+    int from = 0;
+    int to = 0;
+};
+
+// Append-only write-ahead journal. Every mutation is one write(2) to the
+// end of the file; fsync is issued once per syncEvery records (0 = leave
+// it to the OS). Once compactAfter records pile up the caller should fold
+// them into a snapshot and call reset().
+class Journal {
+public:
+    // Where the journal ends, for truncate()
+    struct Position {
+        size_t bytes = 0;
+        size_t records = 0;
+    };
+
+    Journal(const string& path, size_t syncEvery = 0, size_t compactAfter = 10000)
+        : path(path), syncEvery(syncEvery), compactAfter(compactAfter) {}
+
+    // A failed final sync cannot be reported from here; callers that care
+    // call close() first
+    ~Journal() {
+        try {
+            close();
+        } catch (const runtime_error&) {
+        }
+    }
+
+    Journal(const Journal&) = delete;
+    Journal& operator=(const Journal&) = delete;
+
+    void open() {
+        if (fd != -1) {
+            return;
+        }
+        fd = ::open(path.c_str(), O_WRONLY | O_APPEND | O_CREAT, 0644);
+        if (fd == -1) {
+            throw runtime_error("Cannot open journal " + path);
+        }
+    }
+
+    void close() {
+        if (fd != -1) {
+            try {
+                sync();
+            } catch (const runtime_error&) {
+                ::close(fd);
+                fd = -1;
+                throw;
+            }
+            ::close(fd);
+            fd = -1;
+        }
+    }
+
+    void logCreate(const Event& event) {
+        logEvent('C', event);
+    }
+
+    void logUpdate(const Event& event) {
+        logEvent('U', event);
+    }
+
+    void logDelete(int id) {
+        append("D," + to_string(id) + "\n");
+    }
+
+    void logDependency(int fromEventId, int toEventId) {
+        append("E," + to_string(fromEventId) + "," + to_string(toEventId) + "\n");
+    }
+
+    // Forces everything written so far to stable storage. Throws if the
+    // disk reports a failure; the records then still count as unsynced.
+    void sync() {
+        if (fd != -1 && unsynced > 0) {
+            if (::fsync(fd) == -1) {
+                throw runtime_error("Cannot sync journal " + path + ": " + strerror(errno));
+            }
+            unsynced = 0;
+        }
+    }
+
+    bool needsCompaction() const {
+        return records >= compactAfter;
+    }
+
+    size_t size() const {
+        return records;
+    }
+
+    // Records appended since construction; unlike size(), never reset
+    uint64_t appended() const {
+        return appendedRecords;
+    }
+
+    Position position() const {
+        return Position{bytes, records};
+    }
+
+    // Cuts off every record appended since position was taken, as if they
+    // had never been written. The cut is made durable by the next sync().
+    void truncate(const Position& position) {
+        int result = fd != -1 ? ::ftruncate(fd, position.bytes) : ::truncate(path.c_str(), position.bytes);
+        if (result == -1 && !(fd == -1 && errno == ENOENT && position.bytes == 0)) {
+            throw runtime_error("Cannot truncate journal " + path + ": " + strerror(errno));
+        }
+        bytes = position.bytes;
+        records = position.records;
+        unsynced = 1;
+    }
+
+    // Drops all records; call only after they are folded into a durable
+    // snapshot. They need no sync first, and should the truncation itself
+    // be lost, replaying them over the snapshot changes nothing.
+    void reset() {
+        if (fd != -1) {
+            ::close(fd);
+            fd = -1;
+        }
+        unsynced = 0;
+        int truncFd = ::open(path.c_str(), O_WRONLY | O_TRUNC | O_CREAT, 0644);
+        if (truncFd != -1) {
+            ::fsync(truncFd);
+            ::close(truncFd);
+        }
+        bytes = 0;
+        records = 0;
+        open();
+    }
+
+    // Feeds every complete record in the journal to apply, in order, and
+    // returns how many there were. A torn last line from a crash is skipped
+    // and cut off, so the next record appended starts a line of its own.
+    template <typename Apply>
+    size_t replay(Apply apply) {
+        ifstream infile(path, ios::binary);
+        if (!infile.is_open()) {
+            return 0;
+        }
+        string buffer((istreambuf_iterator<char>(infile)), istreambuf_iterator<char>());
+        string_view rest(buffer);
+        size_t count = 0;
+        while (!rest.empty()) {
+            size_t eol = rest.find('\n');
+            if (eol == string_view::npos) {
+                break;
+            }
+            string_view line = rest.substr(0, eol);
+            rest.remove_prefix(eol + 1);
+            JournalRecord record;
+            if (parse(line, record)) {
+                apply(record);
+                ++count;
+            }
+        }
+        bytes = buffer.size() - rest.size();
+        if (!rest.empty() && ::truncate(path.c_str(), bytes) == -1) {
+            throw runtime_error("Cannot cut torn record from journal " + path + ": " + strerror(errno));
+        }
+        records = count;
+        return count;
+    }
+
+private:
+    string path;
+    size_t syncEvery;
+    size_t compactAfter;
+    int fd = -1;
+    size_t bytes = 0; // Length of the file
+    size_t records = 0;
+    size_t unsynced = 0;
+    uint64_t appendedRecords = 0;
+
+    void logEvent(char op, const Event& event) {
+        string line;
+        line += op;
+        line += "," + to_string(event.id) + "," + event.name + "," + event.date() + "," +
+                event.startTime() + "," + event.endTime();
+        if (event.repeats()) {
+            line += "," + event.recurrence.field();
+        }
+        line += "\n";
+        append(line);
+    }
+
+    void append(const string& line) {
+        open();
+        const char* data = line.data();
+        size_t left = line.size();
+        while (left > 0) {
+            ssize_t written = ::write(fd, data, left);
+            if (written < 0) {
+                throw runtime_error("Cannot write journal " + path);
+            }
+            data += written;
+            left -= written;
+        }
+        bytes += line.size();
+        ++records;
+        ++unsynced;
+        ++appendedRecords;
+        if (syncEvery > 0 && unsynced >= syncEvery) {
+            sync();
+        }
+    }
+
+    static bool parse(string_view line, JournalRecord& record) {
+        if (!line.empty() && line.back() == '\r') {
+            line.remove_suffix(1);
+        }
+        string_view op = nextCsvField(line);
+        if (op.size() != 1) {
+            return false;
+        }
+        record.op = op[0];
+        switch (record.op) {
+        case 'C':
+        case 'U': {
+            if (!parseCsvInt(nextCsvField(line), record.event.id)) {
+                return false;
+            }
+            if (!Event::isValidId(record.event.id)) {
+                return false;
+            }
+            string_view name = nextCsvField(line);
+            string_view date = nextCsvField(line);
+            string_view startTime = nextCsvField(line);
+            string_view endTime = nextCsvField(line);
+            if (!Event::isValidDate(date) || !Event::isValidTime(startTime) || !Event::isValidEndTime(endTime)) {
+                return false;
+            }
+            record.event.name.assign(name.data(), name.size());
+            record.event.start = Event::toMinutes(date, startTime);
+            record.event.end = Event::toMinutes(date, endTime);
+            if (record.event.end <= record.event.start) {
+                return false;
+            }
+            // No field for a one-off event
+            string_view rule = nextCsvField(line);
+            return rule.empty() || Recurrence::parse(rule, record.event.recurrence);
+        }
+        case 'D':
+            return parseCsvInt(nextCsvField(line), record.event.id) && Event::isValidId(record.event.id);
+        case 'E':
+            return parseCsvInt(nextCsvField(line), record.from) && parseCsvInt(nextCsvField(line), record.to);
+        default:
+            return false;
+        }
+    }
+};
+
+#endif // JOURNAL_H
@@ -0,0 +1,75 @@
+#ifndef NODEPOOL_H
+#define NODEPOOL_H
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+// Slab allocator for fixed-size tree nodes. Nodes are carved out of
+// SlabSize-element slabs, so neighbours in insertion order are
+// neighbours in memory, and freed nodes go on an intrusive free list for
+// reuse. releaseAll() hands every slab back in O(slabs) calls no matter
+// how many nodes were allocated.
+template <typename T, size_t SlabSize = 1024>
+class NodePool {
+public:
+    NodePool() = default;
+    NodePool(const NodePool&) = delete;
+    NodePool& operator=(const NodePool&) = delete;
+
+    template <typename... Args>
+    T* create(Args&&... args) {
+        Slot* slot = freeList;
+        if (slot != nullptr) {
+            freeList = slot->next;
+        } else {
+            if (slabs.empty() || nextInSlab == SlabSize) {
+                slabs.emplace_back(new Slot[SlabSize]);
+                nextInSlab = 0;
+            }
+            slot = &slabs.back()[nextInSlab++];
+        }
+        ++live;
+        return new (slot->storage) T(std::forward<Args>(args)...);
+    }
+
+    void destroy(T* node) {
+        node->~T();
+        Slot* slot = reinterpret_cast<Slot*>(node);
+        slot->next = freeList;
+        freeList = slot;
+        --live;
+    }
+
+    // Drops every node at once. Destructors are not run; callers whose T
+    // owns resources must destroy the objects (not the memory) first.
+    void releaseAll() {
+        slabs.clear();
+        freeList = nullptr;
+        nextInSlab = SlabSize;
+        live = 0;
+    }
+
+    size_t size() const {
+        return live;
+    }
+
+private:
+    union Slot {
+        Slot* next;
+        alignas(T) unsigned char storage[sizeof(T)];
+
+        Slot() {}
+    };
+
+    vector<unique_ptr<Slot[]>> slabs;
+    Slot* freeList = nullptr;
+    size_t nextInSlab = SlabSize;
+    size_t live = 0;
+};
+
+#endif // NODEPOOL_H
@@ -0,0 +1,421 @@
+#ifndef PERSISTENTAVLTREE_H
+#define PERSISTENTAVLTREE_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <iterator>
+#include <string>
+#include <utility>
+#include <vector>
+#include "Event.h"
+
+using namespace std;
+
+// What a calendar version keeps of an event: the time key, the id and the
+// repeat rule, so conflicts are found on every occurrence. Names stay in
+// the EventStore alone, so the calendar costs a few words per event rather
+// than a second copy of each one.
+struct CalendarEntry {
+    int start;
+    int end;
+    int id;
+    Recurrence recurrence; // start and end are the first occurrence
+
+    CalendarEntry(int start, int end, int id, Recurrence recurrence = Recurrence())
+        : start(start), end(end), id(id), recurrence(recurrence) {}
+
+    CalendarEntry(const Event& event)
+        : start(event.start), end(event.end), id(event.id), recurrence(event.recurrence) {}
+
+    // As an Event without a name, for its occurrences
+    Event times() const {
+        return Event(id, string(), start, end, recurrence);
+    }
+
+    // Ordered exactly like Event
+    bool operator<(const CalendarEntry& other) const {
+        if (start != other.start) return start < other.start;
+        if (end != other.end) return end < other.end;
+        return id < other.id;
+    }
+};
+
+// Node of a persistent tree: never changed once built, and shared by every
+// version that still reaches it. The count is atomic so versions may be
+// copied and dropped on any thread.
+struct PersistentNode {
+    CalendarEntry entry;
+    const PersistentNode* left;
+    const PersistentNode* right;
+    int height;
+    int maxEnd; // Latest end of any occurrence in this subtree, used to prune overlap queries
+    size_t size;
+    mutable atomic<int> refs{1};
+
+    PersistentNode(const CalendarEntry& entry, const PersistentNode* left, const PersistentNode* right)
+        : entry(entry), left(left), right(right) {
+        height = 1 + max(left ? left->height : 0, right ? right->height : 0);
+        int lastEnd = entry.recurrence.repeats() ? entry.times().lastEnd() : entry.end;
+        maxEnd = max({lastEnd, left ? left->maxEnd : lastEnd, right ? right->maxEnd : lastEnd});
+        size = 1 + (left ? left->size : 0) + (right ? right->size : 0);
+    }
+};
+
+// A time-ordered AVL tree whose versions share structure (path copying).
+// insert and remove copy only the O(log n) nodes on the search path,
+// rotations included, and leave every other node shared with the previous
+// version. Copying a tree is O(1) and yields an independent version, so a
+// copy works as a point-in-time snapshot, and assigning an old copy back
+// rolls a failed batch back in O(1).
+//
+// Ordered like AVLTree, by (start, end, id); a moved event is removed
+// under its old times and inserted under its new ones.
+class PersistentAVLTree {
+public:
+    // In-order iterator; holds the path to the current node
+    class const_iterator {
+    public:
+        using iterator_category = forward_iterator_tag;
+        using value_type = CalendarEntry;
+        using difference_type = ptrdiff_t;
+        using pointer = const CalendarEntry*;
+        using reference = const CalendarEntry&;
+
+        const_iterator() = default;
+
+        const CalendarEntry& operator*() const {
+            return path.back()->entry;
+        }
+
+        const CalendarEntry* operator->() const {
+            return &path.back()->entry;
+        }
+
+        const_iterator& operator++() {
+            const PersistentNode* node = path.back();
+            path.pop_back();
+            pushLeft(node->right);
+            return *this;
+        }
+
+        const_iterator operator++(int) {
+            const_iterator old = *this;
+            ++*this;
+            return old;
+        }
+
+        bool operator==(const const_iterator& other) const {
+            return path.empty() ? other.path.empty() : !other.path.empty() && path.back() == other.path.back();
+        }
+
+        bool operator!=(const const_iterator& other) const {
+            return !(*this == other);
+        }
+
+    private:
+        friend class PersistentAVLTree;
+        vector<const PersistentNode*> path;
+
+        void pushLeft(const PersistentNode* t) {
+            for (; t != nullptr; t = t->left) {
+                path.push_back(t);
+            }
+        }
+    };
+
+    PersistentAVLTree() = default;
+
+    PersistentAVLTree(const PersistentAVLTree& other) : root(retain(other.root)) {}
+
+    PersistentAVLTree(PersistentAVLTree&& other) noexcept : root(other.root) {
+        other.root = nullptr;
+    }
+
+    PersistentAVLTree& operator=(const PersistentAVLTree& other) {
+        const PersistentNode* old = root;
+        root = retain(other.root);
+        release(old);
+        return *this;
+    }
+
+    PersistentAVLTree& operator=(PersistentAVLTree&& other) noexcept {
+        swap(root, other.root);
+        return *this;
+    }
+
+    ~PersistentAVLTree() {
+        release(root);
+    }
+
+    // Entries already sorted by operator<, in O(n)
+    static PersistentAVLTree fromSorted(const vector<CalendarEntry>& sorted) {
+        PersistentAVLTree tree;
+        tree.root = build(sorted, 0, sorted.size());
+        return tree;
+    }
+
+    // An entry with the same key is replaced
+    void insert(const CalendarEntry& entry) {
+        const PersistentNode* old = root;
+        root = insert(root, entry);
+        release(old);
+    }
+
+    // False if no entry has this key
+    bool remove(const CalendarEntry& entry) {
+        if (!contains(entry)) {
+            return false;
+        }
+        const PersistentNode* old = root;
+        root = remove(root, entry);
+        release(old);
+        return true;
+    }
+
+    bool contains(const CalendarEntry& entry) const {
+        for (const PersistentNode* t = root; t != nullptr;) {
+            if (entry < t->entry) {
+                t = t->left;
+            } else if (t->entry < entry) {
+                t = t->right;
+            } else {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    size_t size() const {
+        return root ? root->size : 0;
+    }
+
+    bool empty() const {
+        return root == nullptr;
+    }
+
+    // True if both are the same version, or one was copied from the other
+    // with no change since; O(1)
+    bool sameVersion(const PersistentAVLTree& other) const {
+        return root == other.root;
+    }
+
+    const_iterator begin() const {
+        const_iterator it;
+        it.pushLeft(root);
+        return it;
+    }
+
+    const_iterator end() const {
+        return const_iterator();
+    }
+
+    // Calls f for each entry starting in [from, to), in time order
+    template <typename F>
+    void forEachBetween(int from, int to, F f) const {
+        forEachBetween(root, from, to, f);
+    }
+
+    vector<CalendarEntry> entriesBetween(int from, int to) const {
+        vector<CalendarEntry> result;
+        forEachBetween(from, to, [&](const CalendarEntry& entry) { result.push_back(entry); });
+        return result;
+    }
+
+    // Whether any occurrence of entry overlaps any occurrence of a stored
+    // one. Same interval search as AVLTree: subtrees whose last occurrence
+    // ends by the query start, and nodes starting at or after the query's
+    // last end, are pruned. A repeating entry counts to its last occurrence
+    // in maxEnd, so only the paths above repeating entries stay open.
+    bool detectConflicts(const CalendarEntry& entry) const {
+        Event event = entry.times();
+        return detectConflicts(event, event.lastEnd(), root);
+    }
+
+    // Stored entries with an occurrence overlapping one of entry's, each
+    // once, in time order of their first occurrence
+    vector<CalendarEntry> findConflicts(const CalendarEntry& entry) const {
+        vector<CalendarEntry> conflicts;
+        Event event = entry.times();
+        findConflicts(event, event.lastEnd(), root, conflicts);
+        return conflicts;
+    }
+
+private:
+    const PersistentNode* root = nullptr;
+
+    static int height(const PersistentNode* t) {
+        return t ? t->height : 0;
+    }
+
+    static const PersistentNode* retain(const PersistentNode* t) {
+        if (t != nullptr) {
+            t->refs.fetch_add(1, memory_order_relaxed);
+        }
+        return t;
+    }
+
+    // Drops one reference; a node freed this way drops one from each
+    // child in turn. Iterative, so freeing a whole version cannot overflow
+    // the stack.
+    static void release(const PersistentNode* t) {
+        vector<const PersistentNode*> pending;
+        while (true) {
+            if (t != nullptr && t->refs.fetch_sub(1, memory_order_acq_rel) == 1) {
+                pending.push_back(t->left);
+                pending.push_back(t->right);
+                delete t;
+            }
+            if (pending.empty()) {
+                return;
+            }
+            t = pending.back();
+            pending.pop_back();
+        }
+    }
+
+    // A new node over left and right, whose references it takes over
+    static const PersistentNode* node(const CalendarEntry& entry, const PersistentNode* left, const PersistentNode* right) {
+        return new PersistentNode(entry, left, right);
+    }
+
+    // As node(), rotating once or twice if the sides differ in height by
+    // two. Only the nodes the rotation changes are copied; a side built
+    // for this update is copied again and dropped.
+    static const PersistentNode* balance(const CalendarEntry& entry, const PersistentNode* left, const PersistentNode* right) {
+        if (height(left) > height(right) + 1) {
+            const PersistentNode* l = left;
+            const PersistentNode* t;
+            if (height(l->left) >= height(l->right)) {
+                t = node(l->entry, retain(l->left), node(entry, retain(l->right), right));
+            } else {
+                const PersistentNode* lr = l->right;
+                t = node(lr->entry, node(l->entry, retain(l->left), retain(lr->left)),
+                         node(entry, retain(lr->right), right));
+            }
+            release(l);
+            return t;
+        }
+        if (height(right) > height(left) + 1) {
+            const PersistentNode* r = right;
+            const PersistentNode* t;
+            if (height(r->right) >= height(r->left)) {
+                t = node(r->entry, node(entry, left, retain(r->left)), retain(r->right));
+            } else {
+                const PersistentNode* rl = r->left;
+                t = node(rl->entry, node(entry, left, retain(rl->left)),
+                         node(r->entry, retain(rl->right), retain(r->right)));
+            }
+            release(r);
+            return t;
+        }
+        return node(entry, left, right);
+    }
+
+    // Each returns a new subtree the caller owns a reference to; t itself
+    // is left as it was
+    static const PersistentNode* insert(const PersistentNode* t, const CalendarEntry& entry) {
+        if (t == nullptr) {
+            return node(entry, nullptr, nullptr);
+        }
+        if (entry < t->entry) {
+            return balance(t->entry, insert(t->left, entry), retain(t->right));
+        }
+        if (t->entry < entry) {
+            return balance(t->entry, retain(t->left), insert(t->right, entry));
+        }
+        return node(entry, retain(t->left), retain(t->right));
+    }
+
+    // entry must be present
+    static const PersistentNode* remove(const PersistentNode* t, const CalendarEntry& entry) {
+        if (entry < t->entry) {
+            return balance(t->entry, remove(t->left, entry), retain(t->right));
+        }
+        if (t->entry < entry) {
+            return balance(t->entry, retain(t->left), remove(t->right, entry));
+        }
+        if (t->left == nullptr) {
+            return retain(t->right);
+        }
+        if (t->right == nullptr) {
+            return retain(t->left);
+        }
+        const PersistentNode* successor = t->right;
+        while (successor->left != nullptr) {
+            successor = successor->left;
+        }
+        return balance(successor->entry, retain(t->left), removeMin(t->right));
+    }
+
+    static const PersistentNode* removeMin(const PersistentNode* t) {
+        if (t->left == nullptr) {
+            return retain(t->right);
+        }
+        return balance(t->entry, removeMin(t->left), retain(t->right));
+    }
+
+    static const PersistentNode* build(const vector<CalendarEntry>& sorted, size_t lo, size_t hi) {
+        if (lo >= hi) {
+            return nullptr;
+        }
+        size_t mid = lo + (hi - lo) / 2;
+        const PersistentNode* left = build(sorted, lo, mid);
+        const PersistentNode* right = build(sorted, mid + 1, hi);
+        return node(sorted[mid], left, right);
+    }
+
+    template <typename F>
+    static void forEachBetween(const PersistentNode* t, int from, int to, F& f) {
+        if (t == nullptr) {
+            return;
+        }
+        if (t->entry.start >= from) {
+            forEachBetween(t->left, from, to, f);
+            if (t->entry.start >= to) {
+                return;
+            }
+            f(t->entry);
+        }
+        forEachBetween(t->right, from, to, f);
+    }
+
+    static bool overlaps(const Event& event, const CalendarEntry& entry) {
+        if (!event.repeats() && !entry.recurrence.repeats()) {
+            return event.start < entry.end && entry.start < event.end;
+        }
+        return event.overlaps(entry.times());
+    }
+
+    static bool detectConflicts(const Event& event, int lastEnd, const PersistentNode* t) {
+        if (t == nullptr || t->maxEnd <= event.start) {
+            return false;
+        }
+        if (detectConflicts(event, lastEnd, t->left)) {
+            return true;
+        }
+        if (t->entry.start >= lastEnd) {
+            return false;
+        }
+        if (t->entry.id != event.id && overlaps(event, t->entry)) {
+            return true;
+        }
+        return detectConflicts(event, lastEnd, t->right);
+    }
+
+    static void findConflicts(const Event& event, int lastEnd, const PersistentNode* t, vector<CalendarEntry>& out) {
+        if (t == nullptr || t->maxEnd <= event.start) {
+            return;
+        }
+        findConflicts(event, lastEnd, t->left, out);
+        if (t->entry.start >= lastEnd) {
+            return;
+        }
+        if (t->entry.id != event.id && overlaps(event, t->entry)) {
+            out.push_back(t->entry);
+        }
+        findConflicts(event, lastEnd, t->right, out);
+    }
+};
+
+#endif // PERSISTENTAVLTREE_H
@@ -0,0 +1,186 @@
+#ifndef RENDER_H
+#define RENDER_H
+
+#include <cerrno>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace std;
+
+extern char** environ;
+
+// Runs Graphviz off the caller's thread. render() queues a DOT file and
+// returns at once; a single worker turns each into a PNG with dot and
+// opens it with xdg-open. Both run without a shell, with their output
+// sent to /dev/null so they cannot scribble over the ncurses screen.
+//
+// Each queued DOT file is a fresh one from tempDot() that the worker owns
+// and deletes, so a later export never rewrites a file dot is reading.
+// The PNG is written aside and renamed into place, and the viewer is
+// left running on its own; the worker only reaps it later.
+class RenderWorker {
+public:
+    RenderWorker() : worker([this] { work(); }) {}
+
+    // Lets the job in progress finish; queued ones are dropped along with
+    // their DOT files
+    ~RenderWorker() {
+        {
+            lock_guard<mutex> lock(queueMutex);
+            stopping = true;
+            for (const Job& job : jobs) {
+                ::unlink(job.dotPath.c_str());
+            }
+            jobs.clear();
+        }
+        wakeup.notify_all();
+        worker.join();
+        reapViewers();
+    }
+
+    RenderWorker(const RenderWorker&) = delete;
+    RenderWorker& operator=(const RenderWorker&) = delete;
+
+    // A new empty file "<name>.XXXXXX.dot" to export into and hand to render()
+    static string tempDot(const string& name) {
+        string path = name + ".XXXXXX.dot";
+        int fd = mkstemps(&path[0], 4);
+        if (fd == -1) {
+            throw runtime_error("Cannot create a file for " + name + ": " + strerror(errno));
+        }
+        ::close(fd);
+        return path;
+    }
+
+    // Takes over dotPath, which is deleted once rendered
+    void render(const string& dotPath, const string& pngPath, bool open = true) {
+        {
+            lock_guard<mutex> lock(queueMutex);
+            jobs.push_back({dotPath, pngPath, open});
+            ++pendingJobs;
+        }
+        wakeup.notify_one();
+    }
+
+    // Jobs queued or in progress
+    size_t pending() const {
+        lock_guard<mutex> lock(queueMutex);
+        return pendingJobs;
+    }
+
+    // How the most recent job ended, for a status line; empty before any
+    string lastResult() const {
+        lock_guard<mutex> lock(queueMutex);
+        return result;
+    }
+
+private:
+    struct Job {
+        string dotPath;
+        string pngPath;
+        bool open;
+    };
+
+    mutable mutex queueMutex;
+    condition_variable wakeup;
+    deque<Job> jobs;
+    size_t pendingJobs = 0;
+    bool stopping = false;
+    string result;
+    vector<pid_t> viewers; // Started by the worker and not yet reaped
+    thread worker; // Last, so it starts once everything above exists
+
+    void work() {
+        while (true) {
+            Job job;
+            {
+                unique_lock<mutex> lock(queueMutex);
+                wakeup.wait(lock, [this] { return stopping || !jobs.empty(); });
+                if (stopping) {
+                    return;
+                }
+                job = move(jobs.front());
+                jobs.pop_front();
+            }
+            reapViewers();
+            string outcome;
+            string partPath = job.pngPath + ".part";
+            int status = run({"dot", "-Tpng", job.dotPath, "-o", partPath});
+            ::unlink(job.dotPath.c_str());
+            if (status != 0 || ::rename(partPath.c_str(), job.pngPath.c_str()) != 0) {
+                ::unlink(partPath.c_str());
+                outcome = "Rendering " + job.pngPath + " failed; is Graphviz installed?";
+            } else {
+                outcome = "Rendered " + job.pngPath;
+                if (job.open) {
+                    pid_t viewer = spawn({"xdg-open", job.pngPath});
+                    if (viewer != -1) {
+                        viewers.push_back(viewer);
+                    }
+                }
+            }
+            lock_guard<mutex> lock(queueMutex);
+            result = outcome;
+            --pendingJobs;
+        }
+    }
+
+    // Collects viewers that have exited, without waiting for the rest
+    void reapViewers() {
+        size_t kept = 0;
+        for (pid_t pid : viewers) {
+            if (waitpid(pid, nullptr, WNOHANG) == 0) {
+                viewers[kept++] = pid;
+            }
+        }
+        viewers.resize(kept);
+    }
+
+    // Exit status of the command, or -1 if it could not be started
+    static int run(const vector<string>& args) {
+        pid_t pid = spawn(args);
+        if (pid == -1) {
+            return -1;
+        }
+        int status;
+        while (waitpid(pid, &status, 0) == -1) {
+            if (errno != EINTR) {
+                return -1;
+            }
+        }
+        return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+    }
+
+    // Starts the command and returns its pid, or -1 if it could not be
+    // started
+    static pid_t spawn(const vector<string>& args) {
+        vector<char*> argv;
+        for (const string& arg : args) {
+            argv.push_back(const_cast<char*>(arg.c_str()));
+        }
+        argv.push_back(nullptr);
+        posix_spawn_file_actions_t actions;
+        posix_spawn_file_actions_init(&actions);
+        posix_spawn_file_actions_addopen(&actions, STDIN_FILENO, "/dev/null", O_RDONLY, 0);
+        posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, "/dev/null", O_WRONLY, 0);
+        posix_spawn_file_actions_addopen(&actions, STDERR_FILENO, "/dev/null", O_WRONLY, 0);
+        pid_t pid;
+        int failed = posix_spawnp(&pid, argv[0], &actions, nullptr, argv.data(), environ);
+        posix_spawn_file_actions_destroy(&actions);
+        return failed ? -1 : pid;
+    }
+};
+
+#endif // RENDER_H
@@ -0,0 +1,501 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <optional>
+#include <string>
+#include <vector>
+#include <stdexcept>
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+#include "AVLTree.h"
+#include "ConflictAudit.h"
+#include "Epoch.h"
+#include "EventGraph.h"
+#include "Journal.h"
+#include "PersistentAVLTree.h"
+#include "Snapshot.h"
+
+using namespace std;
+
+// The scheduling engine with no front end attached. It owns the event
+// store, the two indexes over it (the dependency graph and the
+// time-ordered tree) and the journal and keeps them in step; failures are
+// reported as runtime_error. The ncurses menu and the headless batch mode
+// both drive it.
+//
+// All changes come from one thread. Other threads read through snapshot
+// readers: publish() hands them the current version of a persistent copy
+// of the tree, and they query whichever version was current when they
+// pinned it, without locks. The menu publishes after each edit, a batch
+// once at its end and the server once per loop pass, after its sync.
+//
+// Changes between begin() and commit() can be taken back with rollback(),
+// for a batch whose journal records could not be made durable. The
+// persistent copy goes back to its saved version in O(1); the other
+// indexes undo each change in turn.
+class Scheduler {
+public:
+    using SnapshotReader = EpochPtr<ScheduleSnapshot>::Reader;
+
+    explicit Scheduler(const string& eventsFile, size_t syncEvery = 0)
+        : eventsFile(eventsFile), graph(store), avlTree(store), journal(eventsFile + ".journal", syncEvery) {}
+
+    // Loads the snapshot and replays the journal tail on top of it.
+    // Throws if the snapshot is unusable; compacting over it would lose data.
+    LoadStats open() {
+        LoadStats stats = graph.loadEvents(eventsFile, avlTree);
+        nextId = stats.maxId + 1;
+        replayedRecords = journal.replay([this](const JournalRecord& record) {
+            apply(record);
+        });
+        // Keys and rules only: names are not copied out of the store
+        vector<CalendarEntry> sorted;
+        sorted.reserve(store.size());
+        for (auto it = avlTree.begin(); it != avlTree.end(); ++it) {
+            const EventKey& key = it.key();
+            sorted.emplace_back(key.start, key.end, key.id, store.recurrence(key.slot));
+        }
+        calendar = PersistentAVLTree::fromSorted(sorted);
+        publish();
+        return stats;
+    }
+
+    // Folds the journal into the events file and empties it
+    void close() {
+        compact();
+        journal.close();
+    }
+
+    int createEvent(const string& name, const string& date, const string& startTime, const string& endTime,
+                    const Recurrence& recurrence = Recurrence()) {
+        validate(date, startTime, endTime, false);
+        if (!Event::isValidId(nextId)) {
+            throw runtime_error("No event ids left");
+        }
+        Event event(nextId, name, date, startTime, endTime);
+        event.recurrence = recurrence;
+        validateSpan(event);
+        validateRecurrence(event);
+        if (avlTree.detectConflicts(event)) {
+            throw runtime_error("Event conflicts with existing events");
+        }
+        graph.addEvent(event);
+        avlTree.reindex(event.id);
+        calendar.insert(event);
+        record(Change{'C', event, {}});
+        journal.logCreate(event);
+        ++nextId;
+        ++writes;
+        maybeCompact();
+        return event.id;
+    }
+
+    // Empty fields, and no recurrence, keep their current value
+    void updateEvent(int id, const string& name, const string& date, const string& startTime, const string& endTime,
+                     const optional<Recurrence>& recurrence = nullopt) {
+        validate(date, startTime, endTime, true);
+        Event before = graph.findEventById(id);
+        Event edited = before;
+        if (!date.empty()) edited.setDate(date);
+        if (!startTime.empty()) edited.setStartTime(startTime);
+        if (!endTime.empty()) edited.setEndTime(endTime);
+        if (recurrence) edited.recurrence = *recurrence;
+        validateSpan(edited);
+        validateRecurrence(edited);
+        // The event's own filed times are skipped by id
+        if (avlTree.detectConflicts(edited)) {
+            throw runtime_error("Event conflicts with existing events");
+        }
+        if (recurrence) {
+            graph.updateEventRecurrence(id, *recurrence);
+        }
+        if (!name.empty()) {
+            graph.updateEventName(id, name);
+        }
+        if (!date.empty()) {
+            graph.updateEventDate(id, date);
+        }
+        if (!startTime.empty()) {
+            graph.updateEventStartTime(id, startTime);
+        }
+        if (!endTime.empty()) {
+            graph.updateEventEndTime(id, endTime);
+        }
+        // Only a new time moves the event in either tree, and a new rule
+        // changes its calendar entry; a rename is seen through the store
+        Event after = graph.findEventById(id);
+        if (!date.empty() || !startTime.empty() || !endTime.empty()) {
+            avlTree.reindex(id);
+        }
+        if (!date.empty() || !startTime.empty() || !endTime.empty() || recurrence) {
+            calendar.remove(before);
+            calendar.insert(after);
+        }
+        record(Change{'U', before, {}});
+        journal.logUpdate(after);
+        ++writes;
+        maybeCompact();
+    }
+
+    void deleteEvent(int id) {
+        Event before = graph.findEventById(id);
+        record(Change{'D', before, graph.dependenciesOf(id)});
+        avlTree.remove(id);
+        calendar.remove(before);
+        graph.deleteEvent(id);
+        journal.logDelete(id);
+        ++writes;
+        maybeCompact();
+    }
+
+    void addDependency(int fromEventId, int toEventId) {
+        graph.findEventById(fromEventId);
+        graph.findEventById(toEventId);
+        bool added = !graph.hasDependency(fromEventId, toEventId);
+        graph.addDependency(fromEventId, toEventId);
+        if (added) {
+            record(Change{'E', Event(), {{fromEventId, toEventId}}});
+        }
+        journal.logDependency(fromEventId, toEventId);
+        maybeCompact();
+    }
+
+    Event findEvent(int id) const {
+        return graph.findEventById(id);
+    }
+
+    vector<Event> topologicalSort() {
+        return graph.topologicalSort();
+    }
+
+    // Events starting in [from, to), minutes since epoch
+    AVLTree::Range eventsBetween(int from, int to) const {
+        return avlTree.range(from, to);
+    }
+
+    // Occurrences after the first of repeating events starting in
+    // [from, to), in time order; eventsBetween has the first
+    vector<Event> repeatsBetween(int from, int to) const {
+        return avlTree.repeatsBetween(from, to);
+    }
+
+    // Number of events starting in [from, to); O(log n)
+    size_t countBetween(int from, int to) const {
+        return avlTree.countInRange(from, to);
+    }
+
+    // Page number page (from 0) of the events starting in [from, to),
+    // pageSize to a page; found in O(log n) however far in it is
+    AVLTree::Range eventsPage(int from, int to, size_t page, size_t pageSize) const {
+        size_t first = avlTree.countInRange(INT_MIN, from);
+        size_t count = avlTree.countInRange(from, to);
+        size_t skip = page <= count / pageSize ? page * pageSize : count;
+        return AVLTree::Range{avlTree.select(first + skip), avlTree.select(first + min(skip + pageSize, count))};
+    }
+
+    // Start of the earliest window of duration minutes at or after from
+    // that no event overlaps
+    int freeSlot(int from, int duration) const {
+        return avlTree.findFreeSlot(from, duration);
+    }
+
+    // freeSlot for many (from, duration) queries at once, across the pool
+    vector<int> freeSlots(const vector<pair<int, int>>& queries) {
+        return avlTree.findFreeSlots(queries, &pool);
+    }
+
+    vector<Event> conflictsWith(const Event& event) const {
+        return avlTree.findConflicts(event);
+    }
+
+    EventTiming timing(int id) const {
+        return graph.timing(id);
+    }
+
+    vector<Event> criticalPath() const {
+        return graph.criticalPath();
+    }
+
+    vector<pair<int, int>> violatedDependencies() const {
+        return graph.violatedDependencies();
+    }
+
+    // Starts keeping what rollback() needs to take back the changes that
+    // follow. Compaction waits for commit(), since it would fold the
+    // changes into the events file.
+    void begin() {
+        savepoint = Savepoint{calendar, journal.position(), writes, nextId};
+        changes.clear();
+    }
+
+    // Keeps the changes since begin(); compacts if that was held back
+    void commit() {
+        savepoint.reset();
+        changes.clear();
+        maybeCompact();
+    }
+
+    // Undoes every change since begin(), newest first, and cuts their
+    // records off the journal. Throws if the journal cannot be cut; the
+    // changes are undone in memory either way.
+    void rollback() {
+        if (!savepoint) {
+            return;
+        }
+        for (auto it = changes.rbegin(); it != changes.rend(); ++it) {
+            undo(*it);
+        }
+        calendar = savepoint->calendar;
+        writes = savepoint->writes;
+        nextId = savepoint->nextId;
+        Journal::Position position = savepoint->journal;
+        savepoint.reset();
+        changes.clear();
+        journal.truncate(position);
+    }
+
+    // Whether changes since begin() await commit() or rollback()
+    bool pending() const {
+        return !changes.empty();
+    }
+
+    // Makes the calendar as it stands visible to snapshot readers. O(1);
+    // does nothing if nothing changed since the last call.
+    void publish() {
+        const ScheduleSnapshot* latest = snapshots.latest();
+        if (latest == nullptr || latest->version() != writes) {
+            snapshots.publish(make_unique<ScheduleSnapshot>(calendar, writes));
+        } else {
+            snapshots.reclaim();
+        }
+    }
+
+    // The calendar as it stands, as a version later changes leave alone;
+    // O(1)
+    PersistentAVLTree calendarVersion() const {
+        return calendar;
+    }
+
+    // One per reading thread; throws once too many are held
+    SnapshotReader snapshotReader() const {
+        return snapshots.reader();
+    }
+
+    // Every overlapping pair in the calendar
+    ConflictPairs auditConflicts() {
+        return ::auditConflicts(avlTree, pool);
+    }
+
+    // Writes a fresh snapshot aside, makes it durable, renames it over the
+    // events file, makes the rename durable and only then truncates the
+    // journal. Throws, leaving the journal as it was, if any step fails;
+    // the events file is then either the old one or the new snapshot, and
+    // replaying the journal over either gives the same calendar.
+    void compact() {
+        string tmp = eventsFile + ".tmp";
+        graph.saveEvents(tmp);
+        if (!syncPath(tmp.c_str(), O_RDONLY)) {
+            string reason = strerror(errno);
+            ::unlink(tmp.c_str());
+            throw runtime_error("Cannot sync " + tmp + ": " + reason);
+        }
+        if (rename(tmp.c_str(), eventsFile.c_str()) != 0) {
+            string reason = strerror(errno);
+            ::unlink(tmp.c_str());
+            throw runtime_error("Cannot replace " + eventsFile + ": " + reason);
+        }
+        // Otherwise a crash could bring the old events file back over a
+        // journal already emptied
+        size_t slash = eventsFile.rfind('/');
+        string dir = slash == string::npos ? "." : slash == 0 ? "/" : eventsFile.substr(0, slash);
+        if (!syncPath(dir.c_str(), O_RDONLY | O_DIRECTORY)) {
+            throw runtime_error("Cannot sync " + dir + ": " + strerror(errno));
+        }
+        journal.reset();
+        // The snapshot holds the changes so far, so they can no longer be
+        // taken back
+        if (savepoint) {
+            begin();
+        }
+    }
+
+    // Makes every change so far durable; for callers that batch fsyncs
+    // with syncEvery 0. Throws if the journal cannot be synced.
+    void sync() {
+        journal.sync();
+    }
+
+    // Journal records written so far; a change to the calendar or the
+    // dependencies moves it
+    uint64_t journaled() const {
+        return journal.appended();
+    }
+
+    size_t journalRecordsReplayed() const {
+        return replayedRecords;
+    }
+
+    const EventGraph& getGraph() const {
+        return graph;
+    }
+
+    const AVLTree& getTree() const {
+        return avlTree;
+    }
+
+private:
+    string eventsFile;
+    EventStore store; // Each event once; graph and avlTree index into it
+    EventGraph graph;
+    AVLTree avlTree;
+    PersistentAVLTree calendar; // avlTree's keys again, as shareable versions
+    Journal journal;
+    ThreadPool pool;
+    EpochPtr<ScheduleSnapshot> snapshots;
+    uint64_t writes = 0; // Event changes so far; the version of each snapshot
+    int nextId = 1;
+    size_t replayedRecords = 0;
+
+    // A change as rollback() takes it back: op as in the journal, the
+    // event as it was before (C: as created) and, for D and E, the
+    // dependencies to restore or drop
+    struct Change {
+        char op;
+        Event before;
+        vector<pair<int, int>> edges;
+    };
+
+    struct Savepoint {
+        PersistentAVLTree calendar;
+        Journal::Position journal;
+        uint64_t writes;
+        int nextId;
+    };
+
+    optional<Savepoint> savepoint; // Set between begin() and commit() or rollback()
+    vector<Change> changes;        // Since begin()
+
+    static void validate(const string& date, const string& startTime, const string& endTime, bool allowEmpty) {
+        if (!(allowEmpty && date.empty()) && !Event::isValidDate(date)) {
+            throw runtime_error("Invalid date, expected YYYY-MM-DD between " + to_string(Event::MIN_YEAR) + " and " +
+                                to_string(Event::MAX_YEAR));
+        }
+        if (!(allowEmpty && startTime.empty()) && !Event::isValidTime(startTime)) {
+            throw runtime_error("Invalid start time, expected HH:MM from 00:00 to 23:59");
+        }
+        if (!(allowEmpty && endTime.empty()) && !Event::isValidEndTime(endTime)) {
+            throw runtime_error("Invalid end time, expected HH:MM up to 24:00");
+        }
+    }
+
+    static void validateSpan(const Event& event) {
+        if (event.end <= event.start) {
+            throw runtime_error("Event must end after it starts");
+        }
+    }
+
+    static constexpr int MAX_REPEAT_DAYS = 36500;
+
+    // Occurrences of a repeating event may not overlap one another
+    static void validateRecurrence(const Event& event) {
+        const Recurrence& rule = event.recurrence;
+        if (rule.every < 0 || rule.every > MAX_REPEAT_DAYS) {
+            throw runtime_error("Invalid repeat interval");
+        }
+        if (!rule.repeats()) {
+            return;
+        }
+        if (event.end - event.start > rule.period()) {
+            throw runtime_error("A repeating event must end before it next starts");
+        }
+        if (rule.until < event.day()) {
+            throw runtime_error("Repeat end date is before the event's date");
+        }
+    }
+
+    // fsync of a file or directory opened with flags; false with errno set
+    static bool syncPath(const char* path, int flags) {
+        int fd = ::open(path, flags);
+        if (fd == -1) {
+            return false;
+        }
+        bool synced = ::fsync(fd) == 0;
+        int error = errno;
+        ::close(fd);
+        errno = error;
+        return synced;
+    }
+
+    // The change that triggered this is already journaled, so a snapshot
+    // that cannot be written just leaves the journal to grow until the
+    // next attempt
+    void maybeCompact() {
+        if (journal.needsCompaction() && !savepoint) {
+            try {
+                compact();
+            } catch (const runtime_error&) {
+            }
+        }
+    }
+
+    void record(Change change) {
+        if (savepoint) {
+            changes.push_back(move(change));
+        }
+    }
+
+    void undo(const Change& change) {
+        int id = change.before.id;
+        switch (change.op) {
+        case 'C':
+            avlTree.remove(id);
+            graph.deleteEvent(id);
+            break;
+        case 'U':
+            graph.addEvent(change.before);
+            avlTree.reindex(id);
+            break;
+        case 'D':
+            graph.addEvent(change.before);
+            avlTree.reindex(id);
+            for (const auto& edge : change.edges) {
+                graph.addDependency(edge.first, edge.second);
+            }
+            break;
+        case 'E':
+            graph.removeDependency(change.edges[0].first, change.edges[0].second);
+            break;
+        }
+    }
+
+    // Applies one journal record on top of the loaded snapshot
+    void apply(const JournalRecord& record) {
+        switch (record.op) {
+        case 'C':
+        case 'U':
+            graph.addEvent(record.event);
+            avlTree.reindex(record.event.id);
+            nextId = max(nextId, record.event.id + 1);
+            ++writes;
+            break;
+        case 'D':
+            avlTree.remove(record.event.id);
+            graph.deleteEvent(record.event.id);
+            ++writes;
+            break;
+        case 'E':
+            try {
+                graph.addDependency(record.from, record.to);
+            } catch (const runtime_error&) {
+                // Was rejected when first applied as well
+            }
+            break;
+        }
+    }
+};
+
+#endif // SCHEDULER_H
@@ -0,0 +1,335 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "Batch.h"
+#include "Scheduler.h"
+
+using namespace std;
+
+// Local service mode: the batch protocol over a Unix domain socket. Each
+// request is one command line exactly as in batch mode, answered by the
+// same lines runCommand writes. Clients may pipeline: every complete line
+// already received is run in order, and all the answers go back in one
+// write. Everything runs on one epoll loop thread, which is also the
+// scheduler's only writer.
+//
+// Changes are journaled without syncing per record; once per loop pass,
+// after running every ready request and before sending any answer, the
+// journal is synced once for all of them (group commit). So a client
+// never sees "ok" for a change that is not durable: if that sync fails,
+// every change made in the pass is rolled back, in memory and in the
+// journal, and its answer becomes an error instead. An error always means
+// the change did not happen. If the journal cannot even be cut back,
+// run() throws rather than serve a calendar the disk disagrees with.
+struct ServerStats {
+    size_t connections = 0;
+    size_t commands = 0;
+    size_t errors = 0;
+};
+
+class Server {
+public:
+    Server(Scheduler& scheduler, const string& socketPath) : scheduler(scheduler), socketPath(socketPath) {}
+
+    ~Server() {
+        for (auto& entry : connections) {
+            ::close(entry.first);
+        }
+        if (listenFd != -1) {
+            ::close(listenFd);
+            unlink(socketPath.c_str());
+        }
+        if (epollFd != -1) ::close(epollFd);
+        if (wakeFd != -1) ::close(wakeFd);
+    }
+
+    Server(const Server&) = delete;
+    Server& operator=(const Server&) = delete;
+
+    // Binds the socket, replacing a stale one left by an earlier run
+    void listen() {
+        sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+        if (socketPath.size() >= sizeof(addr.sun_path)) {
+            throw runtime_error("Socket path too long: " + socketPath);
+        }
+        memcpy(addr.sun_path, socketPath.c_str(), socketPath.size() + 1);
+
+        listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (listenFd == -1) {
+            throw runtime_error(string("socket: ") + strerror(errno));
+        }
+        unlink(socketPath.c_str());
+        if (bind(listenFd, (sockaddr*)&addr, sizeof(addr)) == -1 || ::listen(listenFd, SOMAXCONN) == -1) {
+            throw runtime_error("Cannot listen on " + socketPath + ": " + strerror(errno));
+        }
+
+        epollFd = epoll_create1(EPOLL_CLOEXEC);
+        wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (epollFd == -1 || wakeFd == -1) {
+            throw runtime_error(string("epoll: ") + strerror(errno));
+        }
+        watch(listenFd, EPOLLIN, EPOLL_CTL_ADD);
+        watch(wakeFd, EPOLLIN, EPOLL_CTL_ADD);
+    }
+
+    // Serves until stop(); returns the totals
+    ServerStats run() {
+        vector<epoll_event> ready(256);
+        vector<int> answered;
+        while (!stopping) {
+            int n = epoll_wait(epollFd, ready.data(), ready.size(), -1);
+            if (n == -1) {
+                if (errno == EINTR) continue;
+                throw runtime_error(string("epoll_wait: ") + strerror(errno));
+            }
+            answered.clear();
+            scheduler.begin();
+            for (int i = 0; i < n; ++i) {
+                int fd = ready[i].data.fd;
+                uint32_t events = ready[i].events;
+                if (fd == wakeFd) {
+                    stopping = true;
+                } else if (fd == listenFd) {
+                    accept();
+                } else {
+                    auto it = connections.find(fd);
+                    if (it == connections.end()) {
+                        continue;
+                    }
+                    Connection& conn = it->second;
+                    if (events & EPOLLIN) {
+                        receive(conn);
+                    }
+                    if (events & (EPOLLERR | EPOLLHUP)) {
+                        conn.peerClosed = true;
+                        conn.reading = false;
+                    }
+                    if (!conn.out.empty() || conn.peerClosed) {
+                        answered.push_back(fd);
+                    }
+                }
+            }
+            // One fsync covers every change made in this pass
+            try {
+                scheduler.sync();
+                scheduler.commit();
+            } catch (const runtime_error& e) {
+                retract(e.what());
+                scheduler.rollback();
+            }
+            unsynced.clear();
+            // Snapshot readers see the pass as it was synced, or as before
+            scheduler.publish();
+            for (int fd : answered) {
+                auto it = connections.find(fd);
+                if (it != connections.end()) {
+                    send(it->second);
+                }
+            }
+        }
+        return stats;
+    }
+
+    // Safe from a signal handler or another thread
+    void stop() {
+        uint64_t one = 1;
+        ssize_t ignored = ::write(wakeFd, &one, sizeof(one));
+        (void)ignored;
+    }
+
+private:
+    struct Connection {
+        int fd;
+        string in;         // Received, not yet a complete line
+        string out;        // Answers not yet sent
+        size_t sent = 0;   // Bytes of out already sent
+        bool peerClosed = false;
+        bool reading = true;
+        uint32_t watched = EPOLLIN;
+
+        explicit Connection(int fd) : fd(fd) {}
+    };
+
+    // Where in a connection's out an answer to a change this pass lies
+    struct Unsynced {
+        int fd;
+        size_t from;
+        size_t to;
+    };
+
+    // A client sending this much without a newline is not speaking the
+    // protocol; one this far behind on reading stops being read from
+    static constexpr size_t MAX_LINE = 1 << 20;
+    static constexpr size_t MAX_PENDING = 4 << 20;
+
+    Scheduler& scheduler;
+    string socketPath;
+    int listenFd = -1;
+    int epollFd = -1;
+    int wakeFd = -1;
+    bool stopping = false;
+    unordered_map<int, Connection> connections;
+    vector<Unsynced> unsynced; // In the order run
+    ServerStats stats;
+
+    void watch(int fd, uint32_t events, int op) {
+        epoll_event ev{};
+        ev.events = events;
+        ev.data.fd = fd;
+        epoll_ctl(epollFd, op, fd, &ev);
+    }
+
+    void accept() {
+        while (true) {
+            int fd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd == -1) {
+                return; // EAGAIN, or a client that gave up already
+            }
+            connections.emplace(fd, Connection(fd));
+            watch(fd, EPOLLIN, EPOLL_CTL_ADD);
+            ++stats.connections;
+        }
+    }
+
+    // Reads everything available and runs every complete line
+    void receive(Connection& conn) {
+        char buffer[1 << 16];
+        while (conn.reading) {
+            ssize_t got = ::read(conn.fd, buffer, sizeof(buffer));
+            if (got > 0) {
+                conn.in.append(buffer, got);
+                runLines(conn);
+            } else if (got == 0 || (errno != EAGAIN && errno != EINTR)) {
+                // Answers still go out, but EOF must not keep waking us
+                conn.peerClosed = true;
+                conn.reading = false;
+                return;
+            } else if (errno == EAGAIN) {
+                return;
+            }
+        }
+    }
+
+    void runLines(Connection& conn) {
+        string_view pending(conn.in);
+        size_t used = 0;
+        while (true) {
+            size_t eol = pending.find('\n', used);
+            if (eol == string_view::npos) {
+                break;
+            }
+            string_view line = pending.substr(used, eol - used);
+            used = eol + 1;
+            if (!line.empty() && line.back() == '\r') {
+                line.remove_suffix(1);
+            }
+            if (line.empty() || line[0] == '#') {
+                continue;
+            }
+            ++stats.commands;
+            size_t answer = conn.out.size();
+            uint64_t journaled = scheduler.journaled();
+            if (!runCommand(scheduler, line, conn.out)) {
+                ++stats.errors;
+            }
+            if (scheduler.journaled() != journaled) {
+                unsynced.push_back(Unsynced{conn.fd, answer, conn.out.size()});
+            }
+            if (!scheduler.pending()) {
+                // Nothing to roll back: the command changed nothing, or a
+                // save folded every change so far into the events file
+                unsynced.clear();
+            }
+        }
+        conn.in.erase(0, used);
+        if (conn.in.size() > MAX_LINE) {
+            conn.out += "error,request,Line too long\n";
+            conn.in.clear();
+            conn.peerClosed = true;
+            conn.reading = false;
+        }
+        if (conn.out.size() - conn.sent > MAX_PENDING) {
+            // Back pressure: stop reading until the client drains answers
+            conn.reading = false;
+        }
+    }
+
+    // Sends what the socket takes; drops the connection once the peer is
+    // gone and nothing is left to send
+    void send(Connection& conn) {
+        while (conn.sent < conn.out.size()) {
+            ssize_t put = ::send(conn.fd, conn.out.data() + conn.sent, conn.out.size() - conn.sent, MSG_NOSIGNAL);
+            if (put > 0) {
+                conn.sent += put;
+            } else if (put == -1 && errno == EINTR) {
+                continue;
+            } else if (put == -1 && errno == EAGAIN) {
+                break;
+            } else {
+                drop(conn.fd);
+                return;
+            }
+        }
+        bool drained = conn.sent == conn.out.size();
+        if (drained) {
+            conn.out.clear();
+            conn.sent = 0;
+            if (conn.peerClosed) {
+                drop(conn.fd);
+                return;
+            }
+            // Paused readers resume once drained; runLines left no complete
+            // line behind, and epoll is level triggered, so anything that
+            // arrived meanwhile is reported on the next pass
+            conn.reading = true;
+        }
+        uint32_t wanted = (conn.reading ? (uint32_t)EPOLLIN : 0) | (drained ? 0 : (uint32_t)EPOLLOUT);
+        if (wanted != conn.watched) {
+            watch(conn.fd, wanted, EPOLL_CTL_MOD);
+            conn.watched = wanted;
+        }
+    }
+
+    // Turns the "ok" line closing each answer to a change that did not
+    // reach the disk into "error,<command>,<reason>"; rows before it stay.
+    // Latest first, so earlier answers in the same out have not moved.
+    void retract(const string& reason) {
+        for (size_t i = unsynced.size(); i-- > 0;) {
+            Connection& conn = connections.at(unsynced[i].fd);
+            size_t from = unsynced[i].from;
+            size_t to = unsynced[i].to;
+            size_t last = conn.out.rfind('\n', to - 2);
+            last = last == string::npos || last < from ? from : last + 1;
+            if (conn.out.compare(last, 3, "ok,") != 0) {
+                continue;
+            }
+            size_t nameEnd = min(conn.out.find(',', last + 3), to - 1);
+            string error = "error," + conn.out.substr(last + 3, nameEnd - last - 3) + "," + reason;
+            conn.out.replace(last, to - 1 - last, error);
+            ++stats.errors;
+        }
+    }
+
+    void drop(int fd) {
+        epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+        ::close(fd);
+        connections.erase(fd);
+    }
+};
+
+#endif // SERVER_H
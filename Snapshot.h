@@ -0,0 +1,57 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include "PersistentAVLTree.h"
+
+using namespace std;
+
+// An immutable view of the calendar for concurrent readers: one version of
+// the persistent tree the scheduler keeps beside its AVLTree. Taking one is
+// O(1), since it shares every node later changes did not copy, and no
+// thread changes it afterwards, so any number of threads may query it at
+// once.
+class ScheduleSnapshot {
+public:
+    ScheduleSnapshot(PersistentAVLTree calendar, uint64_t version)
+        : calendar_(move(calendar)), version_(version) {}
+
+    // Counts writes: a later snapshot of the same scheduler has a higher one
+    uint64_t version() const {
+        return version_;
+    }
+
+    size_t size() const {
+        return calendar_.size();
+    }
+
+    // Copying it keeps this version alive past the reader's guard
+    const PersistentAVLTree& calendar() const {
+        return calendar_;
+    }
+
+    // Events starting in [from, to), minutes since epoch, as keys
+    vector<CalendarEntry> entriesBetween(int from, int to) const {
+        return calendar_.entriesBetween(from, to);
+    }
+
+    // Whether any occurrence of entry overlaps any occurrence of a stored
+    // event, as AVLTree::detectConflicts
+    bool hasConflict(const CalendarEntry& entry) const {
+        return calendar_.detectConflicts(entry);
+    }
+
+    // The clashing events, each once, whether one occurrence clashes or
+    // several
+    vector<CalendarEntry> findConflicts(const CalendarEntry& entry) const {
+        return calendar_.findConflicts(entry);
+    }
+
+private:
+    PersistentAVLTree calendar_;
+    uint64_t version_;
+};
+
+#endif // SNAPSHOT_H
@@ -0,0 +1,184 @@
+#ifndef STRINGPOOL_H
+#define STRINGPOOL_H
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+// Interned strings: each distinct string is kept once, named by a small
+// int id. The bytes of all strings share one arena and the lookup table is
+// open addressing over (hash, id) pairs, so a string costs its bytes plus
+// about 30 bytes however often it is used. Strings are reference counted;
+// when the last user releases one its id is reused, and the arena is
+// compacted once more than half of it is dead.
+class StringPool {
+public:
+    // Id of s, adding it if new; each call takes one reference
+    int intern(string_view s) {
+        size_t h = hash<string_view>()(s);
+        size_t pos = probe(s, h);
+        if (table[pos].id >= 0) {
+            ++refs[table[pos].id];
+            return table[pos].id;
+        }
+        int id;
+        if (!freeIds.empty()) {
+            id = freeIds.back();
+            freeIds.pop_back();
+        } else {
+            id = spans.size();
+            spans.emplace_back();
+            refs.push_back(0);
+        }
+        spans[id] = {(uint32_t)bytes.size(), (uint32_t)s.size()};
+        bytes.append(s.data(), s.size());
+        refs[id] = 1;
+        if (table[pos].id == EMPTY) {
+            ++tableUsed;
+        }
+        table[pos] = {(uint32_t)h, id};
+        ++live;
+        if (tableUsed * 2 > table.size()) {
+            rehash(table.size() * 2);
+        }
+        return id;
+    }
+
+    // Room for about count more strings, so a bulk load does not grow the
+    // table step by step
+    void reserve(size_t count) {
+        spans.reserve(spans.size() + count);
+        refs.reserve(refs.size() + count);
+        size_t capacity = table.size();
+        while ((tableUsed + count) * 2 > capacity) {
+            capacity *= 2;
+        }
+        if (capacity != table.size()) {
+            rehash(capacity);
+        }
+    }
+
+    void release(int id) {
+        if (--refs[id] > 0) {
+            return;
+        }
+        table[find(view(id), id)].id = TOMBSTONE;
+        deadBytes += spans[id].second;
+        spans[id] = {0, 0};
+        freeIds.push_back(id);
+        --live;
+        if (deadBytes > 4096 && deadBytes * 2 > bytes.size()) {
+            compact();
+        }
+    }
+
+    // Valid until the next intern or release
+    string_view view(int id) const {
+        return string_view(bytes.data() + spans[id].first, spans[id].second);
+    }
+
+    // Distinct strings in use
+    size_t size() const {
+        return live;
+    }
+
+    void clear() {
+        bytes.clear();
+        spans.clear();
+        refs.clear();
+        freeIds.clear();
+        table.assign(16, Entry());
+        tableUsed = 0;
+        live = 0;
+        deadBytes = 0;
+    }
+
+private:
+    static constexpr int EMPTY = -1;
+    static constexpr int TOMBSTONE = -2;
+
+    string bytes;                            // Every string back to back
+    vector<pair<uint32_t, uint32_t>> spans;  // Id -> (offset, length) in bytes
+    vector<int> refs;
+    vector<int> freeIds;
+    // Lookup table, a power of two in size and at most half used. The low
+    // hash bits kept in each entry settle most mismatches without touching
+    // the arena.
+    struct Entry {
+        uint32_t hash = 0;
+        int id = EMPTY;
+    };
+    vector<Entry> table = vector<Entry>(16);
+    size_t tableUsed = 0;                    // Ids plus tombstones
+    size_t live = 0;
+    size_t deadBytes = 0;
+
+    // Table position holding s, or where it would be inserted
+    size_t probe(string_view s, size_t h) const {
+        size_t mask = table.size() - 1;
+        size_t insertAt = SIZE_MAX;
+        for (size_t pos = h & mask;; pos = (pos + 1) & mask) {
+            const Entry& entry = table[pos];
+            if (entry.id == EMPTY) {
+                return insertAt != SIZE_MAX ? insertAt : pos;
+            }
+            if (entry.id == TOMBSTONE) {
+                if (insertAt == SIZE_MAX) insertAt = pos;
+            } else if (entry.hash == (uint32_t)h && view(entry.id) == s) {
+                return pos;
+            }
+        }
+    }
+
+    // Table position of a stored id
+    size_t find(string_view s, int id) const {
+        size_t mask = table.size() - 1;
+        size_t pos = hash<string_view>()(s) & mask;
+        while (table[pos].id != id) {
+            pos = (pos + 1) & mask;
+        }
+        return pos;
+    }
+
+    void rehash(size_t capacity) {
+        vector<Entry> old(capacity);
+        old.swap(table);
+        tableUsed = 0;
+        for (const Entry& entry : old) {
+            if (entry.id >= 0) {
+                // Only the low 32 bits are kept, so reinsert by those; any
+                // table up to 2^32 entries probes from the same place
+                size_t pos = entry.hash & (capacity - 1);
+                while (table[pos].id != EMPTY) {
+                    pos = (pos + 1) & (capacity - 1);
+                }
+                table[pos] = entry;
+                ++tableUsed;
+            }
+        }
+    }
+
+    // Squeezes dead strings out of the arena; ids stay the same
+    void compact() {
+        string packed;
+        packed.reserve(bytes.size() - deadBytes);
+        for (size_t id = 0; id < spans.size(); ++id) {
+            if (refs[id] > 0) {
+                uint32_t offset = packed.size();
+                packed.append(bytes, spans[id].first, spans[id].second);
+                spans[id].first = offset;
+            }
+        }
+        bytes.swap(packed);
+        deadBytes = 0;
+        // Tombstones go too
+        rehash(table.size());
+    }
+};
+
+#endif // STRINGPOOL_H
@@ -0,0 +1,111 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <algorithm>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+// Fixed set of worker threads fed from one FIFO queue. Work is handed in
+// as coarse tasks (a range of dates, a subtree), so a single locked queue
+// is not a bottleneck.
+class ThreadPool {
+public:
+    explicit ThreadPool(size_t threads = thread::hardware_concurrency()) {
+        threads = max<size_t>(1, threads);
+        for (size_t i = 0; i < threads; ++i) {
+            workers.emplace_back([this] { work(); });
+        }
+    }
+
+    ~ThreadPool() {
+        {
+            lock_guard<mutex> lock(queueMutex);
+            stopping = true;
+        }
+        wakeup.notify_all();
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    size_t size() const {
+        return workers.size();
+    }
+
+    // Queues f and returns a future for its result; exceptions thrown by f
+    // come out of future::get()
+    template <typename F>
+    auto submit(F f) -> future<decltype(f())> {
+        using R = decltype(f());
+        auto task = make_shared<packaged_task<R()>>(move(f));
+        future<R> result = task->get_future();
+        {
+            lock_guard<mutex> lock(queueMutex);
+            tasks.push([task] { (*task)(); });
+        }
+        wakeup.notify_one();
+        return result;
+    }
+
+    // Runs f(i) for every i in [0, n) across the pool and waits for all of
+    // them; the first exception is rethrown here
+    template <typename F>
+    void parallelFor(size_t n, F f) {
+        vector<future<void>> pending;
+        pending.reserve(n);
+        for (size_t i = 0; i < n; ++i) {
+            pending.push_back(submit([&f, i] { f(i); }));
+        }
+        // Every task must finish before f goes out of scope
+        exception_ptr error;
+        for (auto& task : pending) {
+            try {
+                task.get();
+            } catch (...) {
+                if (!error) {
+                    error = current_exception();
+                }
+            }
+        }
+        if (error) {
+            rethrow_exception(error);
+        }
+    }
+
+private:
+    vector<thread> workers;
+    queue<function<void()>> tasks;
+    mutex queueMutex;
+    condition_variable wakeup;
+    bool stopping = false;
+
+    void work() {
+        while (true) {
+            function<void()> task;
+            {
+                unique_lock<mutex> lock(queueMutex);
+                wakeup.wait(lock, [this] { return stopping || !tasks.empty(); });
+                if (stopping && tasks.empty()) {
+                    return;
+                }
+                task = move(tasks.front());
+                tasks.pop();
+            }
+            task();
+        }
+    }
+};
+
+#endif // THREADPOOL_H
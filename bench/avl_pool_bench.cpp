@@ -0,0 +1,69 @@
+// AVLTree node allocation benchmark: pooled nodes vs plain new/delete.
+//
+// CMake builds both as avl_pool_bench and avl_pool_bench_baseline; by hand:
+//
+//   g++ -std=c++17 -O2 -pthread bench/avl_pool_bench.cpp -o avl_pool_bench
+//   g++ -std=c++17 -O2 -pthread -DAVLTREE_NO_POOL bench/avl_pool_bench.cpp -o avl_pool_bench_baseline
+//   ./avl_pool_bench 1000000 && ./avl_pool_bench_baseline 1000000
+//
+// Each run inserts n events, removes every other one, inserts them again,
+// and destroys the tree, timing each phase separately.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include "../AVLTree.h"
+
+using namespace std;
+
+static double secondsSince(chrono::steady_clock::time_point start) {
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char** argv) {
+    size_t n = argc > 1 ? strtoull(argv[1], nullptr, 10) : 1000000;
+
+    mt19937 rng(42);
+    vector<Event> events;
+    events.reserve(n);
+    for (size_t i = 0; i < n; ++i) {
+        Event event((int)i + 1, "event");
+        event.start = 28000000 + (int)(rng() % 5000000);
+        event.end = event.start + 30 + (int)(rng() % 90);
+        events.push_back(event);
+    }
+
+    AVLTree* tree = new AVLTree();
+
+    auto start = chrono::steady_clock::now();
+    for (const auto& event : events) {
+        tree->insert(event);
+    }
+    double insertSeconds = secondsSince(start);
+
+    start = chrono::steady_clock::now();
+    for (size_t i = 0; i < n; i += 2) {
+        tree->remove(events[i]);
+    }
+    double removeSeconds = secondsSince(start);
+
+    start = chrono::steady_clock::now();
+    for (size_t i = 0; i < n; i += 2) {
+        tree->insert(events[i]);
+    }
+    double reinsertSeconds = secondsSince(start);
+
+    start = chrono::steady_clock::now();
+    delete tree;
+    double teardownSeconds = secondsSince(start);
+
+#ifdef AVLTREE_NO_POOL
+    const char* variant = "new/delete";
+#else
+    const char* variant = "pool";
+#endif
+    printf("%-10s n=%zu insert=%.3fs remove=%.3fs reinsert=%.3fs teardown=%.3fs\n",
+           variant, n, insertSeconds, removeSeconds, reinsertSeconds, teardownSeconds);
+    return 0;
+}
@@ -0,0 +1,444 @@
+// Scheduler benchmark suite: AVLTree, PersistentAVLTree and EventGraph
+// operations on synthetic calendars, from thousands to millions of events.
+//
+//   g++ -std=c++17 -O2 -pthread bench/scheduler_bench.cpp -o scheduler_bench
+//   ./scheduler_bench --sizes 1000,10000,100000,1000000 --format json --out bench.json
+//
+// Options:
+//   --sizes a,b,...   calendar sizes to run (default 1000,10000,100000,1000000)
+//   --days N          dates the events are spread over (default 365)
+//   --overlap X       average events in progress at once on a day (default 2)
+//   --shape S         dependency DAG: chain, tree, random or shuffled (default random)
+//   --probes N        conflict probes per size (default 10000)
+//   --format F        csv or json (default csv)
+//   --out FILE        report file (default stdout)
+//   --seed N          generator seed (default 42)
+//   --threads N       conflict audit workers and snapshot reader threads
+//                     (default: all cores)
+//
+// Every row of the report is one operation at one size: ops/sec plus
+// per-call latency percentiles in microseconds and the peak RSS reached so
+// far. Sizes run in ascending order, so peak RSS is that of the largest
+// size run up to that row.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <sys/resource.h>
+#include "../ConflictAudit.h"
+#include "../Epoch.h"
+#include "../EventGraph.h"
+#include "../PersistentAVLTree.h"
+#include "../Snapshot.h"
+
+using namespace std;
+
+struct Config {
+    vector<size_t> sizes{1000, 10000, 100000, 1000000};
+    int days = 365;
+    double overlap = 2;
+    string shape = "random";
+    size_t probes = 10000;
+    string format = "csv";
+    string out;
+    unsigned seed = 42;
+    size_t threads = thread::hardware_concurrency();
+};
+
+struct Result {
+    size_t size;
+    string op;
+    size_t ops;
+    double seconds;
+    double p50, p90, p99, max; // Microseconds
+    long peakRssKb;
+};
+
+// Query results are folded in here and printed at the end, so the
+// compiler cannot drop calls whose result is otherwise unused
+static size_t checksum = 0;
+
+static long peakRssKb() {
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+static Result summarize(size_t size, const string& name, vector<double>& latencies, double seconds) {
+    size_t count = latencies.size();
+    auto percentile = [&](double p) {
+        if (latencies.empty()) {
+            return 0.0;
+        }
+        size_t k = min(latencies.size() - 1, (size_t)(p * latencies.size()));
+        nth_element(latencies.begin(), latencies.begin() + k, latencies.end());
+        return latencies[k];
+    };
+    Result result{size, name, count, seconds, percentile(0.50), percentile(0.90), percentile(0.99), 0, 0};
+    result.max = latencies.empty() ? 0 : *max_element(latencies.begin(), latencies.end());
+    result.peakRssKb = peakRssKb();
+    fprintf(stderr, "%10zu %-22s %12.0f ops/s  p50 %9.2f us  p99 %9.2f us\n",
+            size, name.c_str(), seconds > 0 ? count / seconds : 0, result.p50, result.p99);
+    return result;
+}
+
+// Times each call of op(i) for i in [0, count) separately
+template <typename Op>
+static Result measure(size_t size, const string& name, size_t count, Op op) {
+    vector<double> latencies(count);
+    auto begin = chrono::steady_clock::now();
+    for (size_t i = 0; i < count; ++i) {
+        auto start = chrono::steady_clock::now();
+        op(i);
+        latencies[i] = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count();
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+    return summarize(size, name, latencies, seconds);
+}
+
+// Runs count reads on each of threads reader threads while the calling
+// thread keeps calling write(); each thread gets its own read = makeRead()
+// and calls read(i). Ops/sec is over all readers.
+template <typename MakeRead, typename Write>
+static Result measureReaders(size_t size, const string& name, size_t threads, size_t count, MakeRead makeRead, Write write) {
+    vector<vector<double>> perThread(threads, vector<double>(count));
+    atomic<size_t> running{threads};
+    auto begin = chrono::steady_clock::now();
+    vector<thread> readers;
+    for (size_t t = 0; t < threads; ++t) {
+        readers.emplace_back([&, t] {
+            auto read = makeRead();
+            for (size_t i = 0; i < count; ++i) {
+                auto start = chrono::steady_clock::now();
+                read(i);
+                perThread[t][i] = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count();
+            }
+            --running;
+        });
+    }
+    while (running > 0) {
+        write();
+    }
+    for (auto& reader : readers) {
+        reader.join();
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+    vector<double> latencies;
+    for (auto& part : perThread) {
+        latencies.insert(latencies.end(), part.begin(), part.end());
+    }
+    return summarize(size, name, latencies, seconds);
+}
+
+// Events spread evenly over cfg.days dates starting 2024-01-01, with
+// durations chosen so that on average cfg.overlap events are in progress
+// at any minute of a day
+static vector<Event> generateEvents(size_t n, const Config& cfg, mt19937& rng) {
+    int firstDay = Event::parseDate("2024-01-01");
+    double perDay = max(1.0, (double)n / cfg.days);
+    int meanDuration = max(1, min(1440, (int)(cfg.overlap * 1440 / perDay)));
+    vector<Event> events;
+    events.reserve(n);
+    for (size_t i = 0; i < n; ++i) {
+        Event event((int)i + 1, "e" + to_string(i + 1));
+        int day = firstDay + (int)(rng() % cfg.days);
+        int duration = 1 + (int)(rng() % (2 * meanDuration));
+        duration = min(duration, 1439);
+        int startMinute = (int)(rng() % (1440 - duration));
+        event.start = day * 1440 + startMinute;
+        event.end = event.start + duration;
+        events.push_back(event);
+    }
+    return events;
+}
+
+// Dependency edges as (from, to) event indexes; always acyclic.
+//   chain     i -> i + 1
+//   tree      (i - 1) / 4 -> i
+//   random    two edges into i from the previous 64 events, following
+//             insertion order
+//   shuffled  the same pairs, but within each block of 64 events edges
+//             follow a random permutation, so many of them contradict the
+//             current order and make addDependency reorder
+static vector<pair<int, int>> generateEdges(size_t n, const string& shape, mt19937& rng) {
+    const int window = 64;
+    vector<int> rank(n);
+    for (size_t i = 0; i < n; ++i) {
+        rank[i] = i;
+    }
+    if (shape == "shuffled") {
+        for (size_t block = 0; block < n; block += window) {
+            shuffle(rank.begin() + block, rank.begin() + min(n, block + window), rng);
+        }
+    }
+    vector<pair<int, int>> edges;
+    for (size_t i = 1; i < n; ++i) {
+        if (shape == "chain") {
+            edges.emplace_back(i - 1, i);
+        } else if (shape == "tree") {
+            edges.emplace_back((i - 1) / 4, i);
+        } else {
+            int lo = max(0, (int)i - window);
+            for (int k = 0; k < 2; ++k) {
+                int j = lo + (int)(rng() % (i - lo));
+                if (rank[j] < rank[i]) {
+                    edges.emplace_back(j, i);
+                } else {
+                    edges.emplace_back(i, j);
+                }
+            }
+        }
+    }
+    return edges;
+}
+
+static Event probeEvent(const vector<Event>& events, mt19937& rng) {
+    const Event& base = events[rng() % events.size()];
+    Event probe(-1, "probe");
+    probe.start = base.start - 30 + (int)(rng() % 60);
+    probe.end = probe.start + 1 + (int)(rng() % 60);
+    return probe;
+}
+
+static void runSize(size_t n, const Config& cfg, ThreadPool& pool, vector<Result>& results) {
+    mt19937 rng(cfg.seed);
+    vector<Event> events = generateEvents(n, cfg, rng);
+    vector<pair<int, int>> edges = generateEdges(n, cfg.shape, rng);
+    vector<Event> probes;
+    for (size_t i = 0; i < cfg.probes; ++i) {
+        probes.push_back(probeEvent(events, rng));
+    }
+
+    {
+        AVLTree tree;
+        results.push_back(measure(n, "avl.insert", n, [&](size_t i) { tree.insert(events[i]); }));
+        results.push_back(measure(n, "avl.detectConflicts", probes.size(), [&](size_t i) { checksum += tree.detectConflicts(probes[i]); }));
+        results.push_back(measure(n, "audit.conflicts", 1, [&](size_t) { checksum += auditConflicts(tree, pool).size(); }));
+        results.push_back(measure(n, "avl.rank", probes.size(), [&](size_t i) { checksum += tree.rank(probes[i]); }));
+        results.push_back(measure(n, "avl.select", probes.size(), [&](size_t i) { checksum += (*tree.select(tree.rank(probes[i]) % n)).id; }));
+        results.push_back(measure(n, "avl.countInRange", probes.size(), [&](size_t i) { checksum += tree.countInRange(probes[i].start, probes[i].end + 1440); }));
+        results.push_back(measure(n, "avl.findFreeSlot", probes.size(), [&](size_t i) { checksum += tree.findFreeSlot(probes[i].start, probes[i].end - probes[i].start + 1); }));
+        vector<pair<int, int>> slotQueries;
+        for (const Event& probe : probes) {
+            slotQueries.emplace_back(probe.start, probe.end - probe.start + 1);
+        }
+        results.push_back(measure(n, "avl.findFreeSlots", 1, [&](size_t) { checksum += tree.findFreeSlots(slotQueries, &pool).size(); }));
+        // Even events go by time key, odd ones through the id index
+        results.push_back(measure(n, "avl.remove", (n + 1) / 2, [&](size_t i) { tree.remove(events[2 * i]); }));
+        results.push_back(measure(n, "avl.removeById", n / 2, [&](size_t i) { tree.remove(events[2 * i + 1].id); }));
+    }
+
+    {
+        // The same calendar plus 64 endless daily and weekly series, each
+        // stored once however many occurrences the probes run into
+        AVLTree tree;
+        for (const Event& event : events) {
+            tree.insert(event);
+        }
+        int firstDay = min_element(events.begin(), events.end())->day();
+        for (int i = 0; i < 64; ++i) {
+            Event series((int)n + 1 + i, "series" + to_string(i));
+            series.start = (firstDay + i % 7) * 1440 + (int)(rng() % 1425);
+            series.end = series.start + 15;
+            series.recurrence.every = i % 2 == 0 ? 1 : 7;
+            tree.insert(series);
+        }
+        results.push_back(measure(n, "repeat.detectConflicts", probes.size(), [&](size_t i) { checksum += tree.detectConflicts(probes[i]); }));
+        results.push_back(measure(n, "repeat.findConflicts", probes.size(), [&](size_t i) { checksum += tree.findConflicts(probes[i]).size(); }));
+        results.push_back(measure(n, "repeat.repeatsBetween", probes.size(), [&](size_t i) { checksum += tree.repeatsBetween(probes[i].start, probes[i].start + 7 * 1440).size(); }));
+        results.push_back(measure(n, "repeat.findFreeSlot", probes.size(), [&](size_t i) { checksum += tree.findFreeSlot(probes[i].start, probes[i].end - probes[i].start + 1); }));
+    }
+
+    {
+        // Two departments' calendars of n / 2 events each, merged and then
+        // taken apart again; set operations use the pool
+        vector<Event> halves[2];
+        for (size_t i = 0; i < n; ++i) {
+            halves[i % 2].push_back(events[i]);
+        }
+        for (auto& half : halves) {
+            sort(half.begin(), half.end());
+        }
+        AVLTree merged, other;
+        merged.buildFromSorted(halves[0]);
+        other.buildFromSorted(halves[1]);
+        results.push_back(measure(n, "avl.union", 1, [&](size_t) { merged.unionWith(other, &pool); }));
+        int middle = events[n / 2].start;
+        AVLTree later;
+        results.push_back(measure(n, "avl.splitAt", 1, [&](size_t) { merged.splitAt(middle, later); }));
+        results.push_back(measure(n, "avl.join", 1, [&](size_t) { merged.join(later); }));
+        results.push_back(measure(n, "avl.difference", 1, [&](size_t) { merged.differenceWith(other, &pool); }));
+        checksum += merged.detectConflicts(probes[0]);
+    }
+
+    {
+        // Each change copies its path; holding the previous version makes
+        // every copy survive, as a snapshot reader would
+        PersistentAVLTree calendar;
+        results.push_back(measure(n, "persistent.insert", n, [&](size_t i) { calendar.insert(events[i]); }));
+        results.push_back(measure(n, "persistent.detectConflicts", probes.size(), [&](size_t i) { checksum += calendar.detectConflicts(probes[i]); }));
+        PersistentAVLTree held;
+        results.push_back(measure(n, "persistent.removeHeld", n / 2, [&](size_t i) {
+            held = calendar;
+            calendar.remove(events[2 * i]);
+        }));
+        checksum += held.size() + calendar.size();
+    }
+
+    {
+        EventGraph graph;
+        results.push_back(measure(n, "graph.addEvent", n, [&](size_t i) { graph.addEvent(events[i]); }));
+        results.push_back(measure(n, "graph.addDependency", edges.size(), [&](size_t i) {
+            graph.addDependency(edges[i].first + 1, edges[i].second + 1);
+        }));
+        // The first query settles the timing changes left by the edges
+        results.push_back(measure(n, "graph.criticalPath", 1, [&](size_t) { checksum += graph.criticalPath().size(); }));
+        size_t sorts = max<size_t>(1, min<size_t>(10, 1000000 / n));
+        results.push_back(measure(n, "graph.topologicalSort", sorts, [&](size_t) { checksum += graph.topologicalSort().size(); }));
+
+        string path = "scheduler_bench_events.txt";
+        size_t rounds = max<size_t>(1, min<size_t>(5, 1000000 / n));
+        results.push_back(measure(n, "graph.saveEvents", rounds, [&](size_t) { graph.saveEvents(path); }));
+        // Set up as the Scheduler does: both indexes over one store
+        results.push_back(measure(n, "graph.loadEvents", rounds, [&](size_t) {
+            EventStore store;
+            EventGraph loaded(store);
+            AVLTree tree(store);
+            checksum += loaded.loadEvents(path, tree).events;
+        }));
+        remove(path.c_str());
+    }
+
+    {
+        EventStore store;
+        EventGraph graph(store);
+        AVLTree tree(store);
+        PersistentAVLTree calendar;
+        for (const Event& event : events) {
+            graph.addEvent(event);
+            tree.reindex(event.id);
+            calendar.insert(event);
+        }
+        EpochPtr<ScheduleSnapshot> snapshots;
+        uint64_t version = 0;
+        auto publish = [&] { snapshots.publish(make_unique<ScheduleSnapshot>(calendar, ++version)); };
+        size_t rounds = max<size_t>(1, min<size_t>(10, 1000000 / n));
+        results.push_back(measure(n, "snapshot.publish", rounds, [&](size_t) { publish(); }));
+
+        // Readers query pinned snapshots while the writer moves events
+        // and publishes as fast as it can
+        size_t moved = 0;
+        auto write = [&] {
+            Event before = graph.findEventById(events[moved++ % n].id);
+            Event shifted = before;
+            shifted.start += 1;
+            shifted.end += 1;
+            graph.addEvent(shifted);
+            tree.reindex(shifted.id);
+            calendar.remove(before);
+            calendar.insert(shifted);
+            publish();
+        };
+        for (size_t threads : {(size_t)1, cfg.threads}) {
+            auto makeRead = [&] {
+                return [&, reader = snapshots.reader()](size_t i) {
+                    auto snapshot = reader.pin();
+                    checksum += snapshot->hasConflict(probes[i % probes.size()]);
+                };
+            };
+            results.push_back(measureReaders(n, "snapshot.read.t" + to_string(threads), threads, probes.size(), makeRead, write));
+            if (threads == cfg.threads) {
+                break;
+            }
+        }
+    }
+}
+
+static void writeReport(const vector<Result>& results, const Config& cfg, ostream& out) {
+    if (cfg.format == "json") {
+        out << "{\"days\":" << cfg.days << ",\"overlap\":" << cfg.overlap << ",\"shape\":\"" << cfg.shape
+            << "\",\"results\":[\n";
+        for (size_t i = 0; i < results.size(); ++i) {
+            const Result& r = results[i];
+            out << "{\"size\":" << r.size << ",\"op\":\"" << r.op << "\",\"ops\":" << r.ops
+                << ",\"seconds\":" << r.seconds << ",\"ops_per_sec\":" << (r.seconds > 0 ? r.ops / r.seconds : 0)
+                << ",\"p50_us\":" << r.p50 << ",\"p90_us\":" << r.p90 << ",\"p99_us\":" << r.p99
+                << ",\"max_us\":" << r.max << ",\"peak_rss_kb\":" << r.peakRssKb << "}"
+                << (i + 1 < results.size() ? ",\n" : "\n");
+        }
+        out << "]}\n";
+    } else {
+        out << "size,op,ops,seconds,ops_per_sec,p50_us,p90_us,p99_us,max_us,peak_rss_kb\n";
+        for (const Result& r : results) {
+            out << r.size << "," << r.op << "," << r.ops << "," << r.seconds << ","
+                << (r.seconds > 0 ? r.ops / r.seconds : 0) << "," << r.p50 << "," << r.p90 << ","
+                << r.p99 << "," << r.max << "," << r.peakRssKb << "\n";
+        }
+    }
+}
+
+static vector<size_t> parseSizes(const string& list) {
+    vector<size_t> sizes;
+    stringstream ss(list);
+    string item;
+    while (getline(ss, item, ',')) {
+        sizes.push_back(strtoull(item.c_str(), nullptr, 10));
+    }
+    return sizes;
+}
+
+int main(int argc, char** argv) {
+    Config cfg;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        string arg = argv[i];
+        string value = argv[i + 1];
+        if (arg == "--sizes") {
+            cfg.sizes = parseSizes(value);
+        } else if (arg == "--days") {
+            cfg.days = max(1, atoi(value.c_str()));
+        } else if (arg == "--overlap") {
+            cfg.overlap = atof(value.c_str());
+        } else if (arg == "--shape") {
+            cfg.shape = value;
+        } else if (arg == "--probes") {
+            cfg.probes = strtoull(value.c_str(), nullptr, 10);
+        } else if (arg == "--format") {
+            cfg.format = value;
+        } else if (arg == "--out") {
+            cfg.out = value;
+        } else if (arg == "--threads") {
+            cfg.threads = strtoull(value.c_str(), nullptr, 10);
+        } else if (arg == "--seed") {
+            cfg.seed = strtoul(value.c_str(), nullptr, 10);
+        } else {
+            fprintf(stderr, "unknown option %s\n", arg.c_str());
+            return 1;
+        }
+    }
+    sort(cfg.sizes.begin(), cfg.sizes.end());
+
+    ThreadPool pool(cfg.threads);
+    vector<Result> results;
+    for (size_t n : cfg.sizes) {
+        if (n > 0) {
+            runSize(n, cfg, pool, results);
+        }
+    }
+
+    fprintf(stderr, "checksum %zu\n", checksum);
+    if (cfg.out.empty()) {
+        writeReport(results, cfg, cout);
+    } else {
+        ofstream out(cfg.out);
+        writeReport(results, cfg, out);
+    }
+    return 0;
+}
@@ -0,0 +1,31 @@
+#ifndef CHECK_H
+#define CHECK_H
+
+#include <cstdio>
+
+// Minimal test support. CHECK reports a failed expectation and carries on,
+// so one run lists every one that broke; main returns checkResult().
+
+inline int& checkFailures() {
+    static int failures = 0;
+    return failures;
+}
+
+#define CHECK(cond)                                                                  \
+    do {                                                                             \
+        if (!(cond)) {                                                               \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            ++checkFailures();                                                       \
+        }                                                                            \
+    } while (0)
+
+inline int checkResult(const char* name) {
+    if (checkFailures() > 0) {
+        fprintf(stderr, "%s: %d checks failed\n", name, checkFailures());
+        return 1;
+    }
+    printf("%s: ok\n", name);
+    return 0;
+}
+
+#endif // CHECK_H
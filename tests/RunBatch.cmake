@@ -0,0 +1,31 @@
+# Runs one batch script on an empty events file and compares stdout with
+# the expected output. Exit code 2 only means some command failed, which
+# the scripts do on purpose; the expected output records which. The script
+# runs in its own directory, and each file in FILES, if that directory
+# exists, must match the file of the same name the script wrote there.
+file(REMOVE_RECURSE ${WORK})
+file(MAKE_DIRECTORY ${WORK})
+execute_process(COMMAND ${SCHEDULER} --events ${WORK}/events.txt --batch ${INPUT}
+                WORKING_DIRECTORY ${WORK}
+                OUTPUT_FILE ${WORK}/output.txt
+                RESULT_VARIABLE result)
+if(NOT result EQUAL 0 AND NOT result EQUAL 2)
+    message(FATAL_ERROR "scheduler exited with ${result}")
+endif()
+execute_process(COMMAND ${CMAKE_COMMAND} -E compare_files ${WORK}/output.txt ${EXPECTED}
+                RESULT_VARIABLE differs)
+if(differs)
+    file(READ ${WORK}/output.txt output)
+    message(FATAL_ERROR "output differs from ${EXPECTED}:\n${output}")
+endif()
+
+file(GLOB expectedFiles ${FILES}/*)
+foreach(expected ${expectedFiles})
+    get_filename_component(written ${expected} NAME)
+    execute_process(COMMAND ${CMAKE_COMMAND} -E compare_files ${WORK}/${written} ${expected}
+                    RESULT_VARIABLE differs)
+    if(differs)
+        file(READ ${WORK}/${written} output)
+        message(FATAL_ERROR "${written} differs from ${expected}:\n${output}")
+    endif()
+endforeach()
@@ -0,0 +1,99 @@
+// Conflict audit: the pairs the parallel per-date sweep and the repeating
+// event searches report must be exactly the overlapping pairs a brute
+// force over every occurrence finds, each once with the earlier event
+// first, and the same for any number of workers.
+
+#include <algorithm>
+#include <map>
+#include <random>
+#include <set>
+#include <vector>
+#include "../AVLTree.h"
+#include "../ConflictAudit.h"
+#include "Check.h"
+
+using namespace std;
+
+using Span = pair<long long, long long>;
+
+// Past every occurrence that can clash: first dates are within `days`, and
+// endless rules of these periods line up again within 42 days
+static long long horizon(int days) {
+    return (long long)(days + 100) * 1440;
+}
+
+static vector<Span> occurrences(const Event& event, long long until) {
+    vector<Span> spans;
+    long long period = event.recurrence.period();
+    long long count = event.occurrences();
+    for (long long k = 0; k < count; ++k) {
+        long long start = event.start + k * period;
+        if (start > until) break;
+        spans.emplace_back(start, event.end + k * period);
+        if (!event.repeats()) break;
+    }
+    return spans;
+}
+
+static bool bruteOverlap(const Event& a, const Event& b, long long until) {
+    for (const Span& x : occurrences(a, until)) {
+        for (const Span& y : occurrences(b, until)) {
+            if (x.first < y.second && y.first < x.second) return true;
+        }
+    }
+    return false;
+}
+
+// Within one date, as Scheduler::validate keeps them; now and then empty
+static Event randomEvent(mt19937& rng, int id, int days, bool series) {
+    int day = (int)(rng() % days);
+    int start = (int)(rng() % 1440);
+    int length = rng() % 20 == 0 ? 0 : 1 + (int)(rng() % 180);
+    Event event(id, "e" + to_string(id), day * 1440 + start, day * 1440 + min(1440, start + length));
+    if (series) {
+        static const int every[] = {1, 2, 3, 7};
+        event.recurrence.every = every[rng() % 4];
+        if (rng() % 2) event.recurrence.until = day + (int)(rng() % 30);
+    }
+    return event;
+}
+
+int main() {
+    mt19937 rng(13);
+    ThreadPool single(1), several(4);
+    for (int round = 0; round < 300; ++round) {
+        // Mostly crowded dates; some rounds spread thin over years
+        int days = round % 5 == 0 ? 5000 : 1 + (int)(rng() % 20);
+        int n = (int)(rng() % 120);
+        bool withSeries = round % 3 != 0;
+        AVLTree tree;
+        map<int, Event> reference;
+        for (int id = 1; id <= n; ++id) {
+            Event event = randomEvent(rng, id, days, withSeries && rng() % 8 == 0);
+            tree.insert(event);
+            reference[id] = event;
+        }
+
+        set<pair<int, int>> expected;
+        for (auto a = reference.begin(); a != reference.end(); ++a) {
+            for (auto b = next(a); b != reference.end(); ++b) {
+                if (bruteOverlap(a->second, b->second, horizon(days))) {
+                    expected.emplace(a->first, b->first);
+                }
+            }
+        }
+
+        ConflictPairs pairs = auditConflicts(tree, several);
+        CHECK(pairs == auditConflicts(tree, single));
+        set<pair<int, int>> reported;
+        for (const auto& clash : pairs) {
+            const Event& first = reference[clash.first];
+            const Event& second = reference[clash.second];
+            CHECK(first.start <= second.start);
+            reported.emplace(min(clash.first, clash.second), max(clash.first, clash.second));
+        }
+        CHECK(reported.size() == pairs.size());
+        CHECK(reported == expected);
+    }
+    return checkResult("audit_test");
+}
@@ -0,0 +1,133 @@
+// EdgeStore: successors, predecessors and counts against a set of edges
+// through random adds, removes, node deletes, rebuilds and compactions,
+// with enough changes to cross the automatic compaction thresholds; and
+// EventGraph dependencies surviving the delete of another event whose
+// slot is then reused.
+
+#include <algorithm>
+#include <random>
+#include <set>
+#include <utility>
+#include <vector>
+#include "../EdgeStore.h"
+#include "../EventGraph.h"
+#include "Check.h"
+
+using namespace std;
+
+using Edges = set<pair<int, int>>;
+
+static bool matches(const EdgeStore& store, const Edges& reference, size_t nodes) {
+    if (store.edgeCount() != reference.size()) return false;
+    for (size_t v = 0; v < nodes; ++v) {
+        vector<int> out, in, wantOut, wantIn;
+        store.forEachSuccessor(v, [&](int w) { out.push_back(w); });
+        store.forEachPredecessor(v, [&](int u) { in.push_back(u); });
+        for (const auto& edge : reference) {
+            if (edge.first == (int)v) wantOut.push_back(edge.second);
+            if (edge.second == (int)v) wantIn.push_back(edge.first);
+        }
+        sort(out.begin(), out.end());
+        sort(in.begin(), in.end());
+        sort(wantIn.begin(), wantIn.end());
+        if (out != wantOut || in != wantIn || store.inDegree(v) != wantIn.size()) return false;
+    }
+    return true;
+}
+
+static void checkRandom(mt19937& rng) {
+    EdgeStore store;
+    Edges reference;
+    size_t nodes = 50;
+    store.resize(nodes);
+    for (int step = 0; step < 60000; ++step) {
+        int from = (int)(rng() % nodes), to = (int)(rng() % nodes);
+        switch (rng() % 16) {
+        case 0:
+            // Rebuilt from scratch, then changed on top; rare, so the delta
+            // and tombstones grow past their compaction thresholds between
+            if (rng() % 400 == 0) {
+                vector<pair<int, int>> edges(reference.begin(), reference.end());
+                store.build(edges, nodes);
+            }
+            break;
+        case 1:
+            if (rng() % 400 == 0) store.compact();
+            break;
+        case 2:
+            if (rng() % 10 == 0) {
+                store.removeNode(from);
+                for (auto it = reference.begin(); it != reference.end();) {
+                    it = it->first == from || it->second == from ? reference.erase(it) : next(it);
+                }
+            }
+            break;
+        case 3:
+            if (nodes < 400 && rng() % 50 == 0) {
+                nodes += 10;
+                store.resize(nodes);
+            }
+            break;
+        case 4:
+        case 5:
+        case 6:
+        case 7:
+        case 8:
+            CHECK(store.removeEdge(from, to) == (reference.erase({from, to}) == 1));
+            break;
+        default:
+            CHECK(store.hasEdge(from, to) == (reference.count({from, to}) == 1));
+            if (from != to && !reference.count({from, to})) {
+                store.addEdge(from, to);
+                reference.emplace(from, to);
+            }
+            break;
+        }
+        if (step % 3000 == 0) {
+            CHECK(matches(store, reference, nodes));
+        }
+    }
+    CHECK(matches(store, reference, nodes));
+    store.compact();
+    CHECK(matches(store, reference, nodes));
+}
+
+// Through EventGraph: deleting one event drops only its own dependencies,
+// and the next event takes its slot without inheriting any
+static void checkGraph() {
+    EventGraph graph;
+    for (int id = 1; id <= 6; ++id) {
+        graph.addEvent(Event(id, "e", id * 100, id * 100 + 30));
+    }
+    graph.addDependency(1, 2);
+    graph.addDependency(2, 3);
+    graph.addDependency(3, 4);
+    graph.addDependency(1, 5);
+    graph.addDependency(5, 6);
+    graph.addDependency(2, 6);
+    graph.deleteEvent(2);
+    CHECK(!graph.hasDependency(1, 2) && !graph.hasDependency(2, 3) && !graph.hasDependency(2, 6));
+    CHECK(graph.hasDependency(3, 4) && graph.hasDependency(1, 5) && graph.hasDependency(5, 6));
+    graph.addEvent(Event(7, "e", 700, 730));
+    CHECK(graph.dependenciesOf(7).empty());
+    graph.addDependency(6, 7);
+    graph.addDependency(7, 3);
+    vector<pair<int, int>> around = graph.dependenciesOf(7);
+    sort(around.begin(), around.end());
+    CHECK(around == (vector<pair<int, int>>{{6, 7}, {7, 3}}));
+
+    vector<int> order;
+    for (const Event& event : graph.topologicalSort()) {
+        order.push_back(event.id);
+    }
+    auto at = [&](int id) { return find(order.begin(), order.end(), id) - order.begin(); };
+    CHECK(order.size() == 6);
+    CHECK(at(1) < at(5) && at(5) < at(6) && at(6) < at(7) && at(7) < at(3) && at(3) < at(4));
+}
+
+int main() {
+    mt19937 rng(8);
+    checkRandom(rng);
+    checkGraph();
+    return checkResult("edge_test");
+}
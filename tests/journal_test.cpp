@@ -0,0 +1,188 @@
+// Crash recovery: a Scheduler dropped without close() leaves its changes
+// only in the journal, and the next open() must replay them, skipping a
+// torn last line or a corrupt record but nothing after it. The events
+// file loader must drop the same corrupt records.
+
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "../Scheduler.h"
+#include "Check.h"
+
+using namespace std;
+
+static string readFile(const string& path) {
+    ifstream in(path, ios::binary);
+    return string((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+}
+
+static void writeFile(const string& path, const string& content) {
+    ofstream out(path, ios::binary | ios::trunc);
+    out << content;
+}
+
+static bool exists(const Scheduler& scheduler, int id) {
+    try {
+        scheduler.findEvent(id);
+        return true;
+    } catch (const runtime_error&) {
+        return false;
+    }
+}
+
+// The state the changes below leave: A moved to 09:00-11:30 and renamed,
+// a daily B depending on A, C created and deleted again
+static void checkRecovered(Scheduler& scheduler) {
+    CHECK(exists(scheduler, 1) && exists(scheduler, 2) && !exists(scheduler, 3));
+    Event a = scheduler.findEvent(1);
+    CHECK(a.name == "Plan" && a.startTime() == "09:00" && a.endTime() == "11:30");
+    Event b = scheduler.findEvent(2);
+    CHECK(b.repeats() && b.recurrence.every == 1);
+    // With the dependency, B can start as soon as A finishes
+    CHECK(scheduler.timing(2).earliestStart == a.end);
+}
+
+int main() {
+    char dirTemplate[] = "/tmp/journal_test.XXXXXX";
+    const char* dir = mkdtemp(dirTemplate);
+    if (dir == nullptr) {
+        perror("mkdtemp");
+        return 1;
+    }
+    string events = string(dir) + "/events.txt";
+    string journal = events + ".journal";
+
+    {
+        Scheduler scheduler(events);
+        scheduler.open();
+        CHECK(scheduler.createEvent("A", "2024-05-06", "10:00", "11:00") == 1);
+        CHECK(scheduler.createEvent("B", "2024-05-06", "12:00", "13:00", Recurrence{1, INT_MAX}) == 2);
+        scheduler.addDependency(1, 2);
+        scheduler.updateEvent(1, "Plan", "", "09:00", "11:30");
+        CHECK(scheduler.createEvent("C", "2024-05-07", "08:00", "08:30") == 3);
+        scheduler.deleteEvent(3);
+        scheduler.sync();
+        checkRecovered(scheduler);
+        // Dropped without close(), as if the process died here
+    }
+    string records = readFile(journal);
+    CHECK(readFile(events).empty());
+
+    {
+        Scheduler scheduler(events);
+        scheduler.open();
+        CHECK(scheduler.journalRecordsReplayed() == 6);
+        checkRecovered(scheduler);
+    }
+
+    // A write cut short: the partial record is ignored, and cut off so the
+    // next record is not glued onto it
+    writeFile(journal, records + "C,9,Torn,2024-05-0");
+    {
+        Scheduler scheduler(events);
+        scheduler.open();
+        CHECK(scheduler.journalRecordsReplayed() == 6);
+        checkRecovered(scheduler);
+        CHECK(!exists(scheduler, 9));
+        CHECK(scheduler.createEvent("After", "2024-05-08", "08:00", "08:30") == 4);
+        scheduler.sync();
+    }
+    {
+        Scheduler scheduler(events);
+        scheduler.open();
+        CHECK(scheduler.journalRecordsReplayed() == 7);
+        CHECK(exists(scheduler, 4));
+    }
+
+    // A whole record is only trusted once its newline made it to disk
+    writeFile(journal, records + "D,1");
+    {
+        Scheduler scheduler(events);
+        scheduler.open();
+        CHECK(scheduler.journalRecordsReplayed() == 6);
+        checkRecovered(scheduler);
+    }
+
+    // A corrupt record in the middle is skipped, the rest still applied
+    writeFile(journal, "C,-3,Bad,2024-05-06,10:00,11:00\nC,4,Late,9999-01-01,10:00,11:00\n"
+                       "C,5,Backwards,2024-05-07,15:00,09:00\nC,6,Empty,2024-05-07,13:00,13:00\n"
+                       "C,7,Rule,2024-05-07,08:00,09:00,R:x\n" +
+                           records);
+    {
+        Scheduler scheduler(events);
+        scheduler.open();
+        CHECK(scheduler.journalRecordsReplayed() == 6);
+        checkRecovered(scheduler);
+        for (int id = 4; id <= 7; ++id) {
+            CHECK(!exists(scheduler, id));
+        }
+    }
+
+    // Replaying twice, as after a crash between snapshot and truncation,
+    // leaves the same state; new ids continue after the replayed ones
+    writeFile(journal, records + records);
+    {
+        Scheduler scheduler(events);
+        scheduler.open();
+        checkRecovered(scheduler);
+        CHECK(scheduler.createEvent("D", "2024-05-08", "08:00", "08:30") == 4);
+        scheduler.close();
+    }
+    CHECK(readFile(journal).empty());
+
+    // After a clean close everything is in the events file
+    {
+        Scheduler scheduler(events);
+        scheduler.open();
+        CHECK(scheduler.journalRecordsReplayed() == 0);
+        checkRecovered(scheduler);
+        CHECK(exists(scheduler, 4));
+    }
+
+    // A snapshot that cannot replace the events file is thrown away and
+    // the journal kept
+    {
+        Scheduler scheduler(events);
+        scheduler.open();
+        scheduler.createEvent("E", "2024-05-09", "08:00", "08:30");
+        scheduler.sync();
+        unlink(events.c_str());
+        mkdir(events.c_str(), 0700);
+        writeFile(events + "/keep", "");
+        bool thrown = false;
+        try {
+            scheduler.compact();
+        } catch (const runtime_error&) {
+            thrown = true;
+        }
+        CHECK(thrown);
+        CHECK(access((events + ".tmp").c_str(), F_OK) != 0);
+        CHECK(!readFile(journal).empty());
+        unlink((events + "/keep").c_str());
+        rmdir(events.c_str());
+    }
+
+    // The events file loader drops the same bad lines, counting them
+    writeFile(events, "1,Bad,2024-05-06,12:00,10:00\n2,Zero,2024-05-06,13:00,13:00\n"
+                      "3,Rule,2024-05-06,14:00,15:00,R:1:2024-02-30\n4,Late,9999-01-01,10:00,11:00\n"
+                      "5,Good,2024-05-06,16:00,17:00,R:7\n");
+    writeFile(journal, "");
+    {
+        Scheduler scheduler(events);
+        LoadStats stats = scheduler.open();
+        CHECK(stats.skipped == 4);
+        CHECK(!exists(scheduler, 1) && !exists(scheduler, 2) && !exists(scheduler, 3) && !exists(scheduler, 4));
+        CHECK(exists(scheduler, 5) && scheduler.findEvent(5).recurrence.every == 7);
+        Event probe(-1, "", "2024-05-06", "11:00", "11:30");
+        CHECK(scheduler.conflictsWith(probe).empty());
+    }
+
+    unlink(journal.c_str());
+    unlink(events.c_str());
+    rmdir(dir);
+    return checkResult("journal_test");
+}
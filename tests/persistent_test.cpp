@@ -0,0 +1,154 @@
+// PersistentAVLTree: every version kept stays as it was while later ones
+// change, a change copies only O(log n) nodes, and dropping the last
+// version that reaches a node frees it.
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <random>
+#include <set>
+#include <tuple>
+#include <unordered_set>
+#include <vector>
+#include "../PersistentAVLTree.h"
+#include "Check.h"
+
+using namespace std;
+
+// Allocations not yet freed, to see nodes released
+static atomic<long> liveAllocations{0};
+
+void* operator new(size_t size) {
+    void* p = malloc(size == 0 ? 1 : size);
+    if (p == nullptr) throw bad_alloc();
+    ++liveAllocations;
+    return p;
+}
+
+void operator delete(void* p) noexcept {
+    if (p != nullptr) {
+        --liveAllocations;
+        free(p);
+    }
+}
+
+void operator delete(void* p, size_t) noexcept {
+    operator delete(p);
+}
+
+using Key = tuple<int, int, int>;
+
+static bool matches(const PersistentAVLTree& tree, const set<Key>& reference) {
+    if (tree.size() != reference.size()) return false;
+    auto expected = reference.begin();
+    for (const CalendarEntry& entry : tree) {
+        if (expected == reference.end() || Key(entry.start, entry.end, entry.id) != *expected) return false;
+        ++expected;
+    }
+    return expected == reference.end();
+}
+
+// Nodes of tree that base does not share, by the address of their entries
+static size_t unshared(const PersistentAVLTree& tree, const PersistentAVLTree& base) {
+    unordered_set<const CalendarEntry*> shared;
+    for (auto it = base.begin(); it != base.end(); ++it) {
+        shared.insert(&*it);
+    }
+    size_t count = 0;
+    for (auto it = tree.begin(); it != tree.end(); ++it) {
+        count += shared.count(&*it) == 0;
+    }
+    return count;
+}
+
+static void checkVersions(mt19937& rng) {
+    PersistentAVLTree tree;
+    set<Key> reference;
+    vector<pair<PersistentAVLTree, set<Key>>> versions;
+    for (int step = 0; step < 3000; ++step) {
+        int id = 1 + (int)(rng() % 500);
+        int start = (int)(rng() % 10000);
+        CalendarEntry entry(start, start + 1 + (int)(rng() % 100), id);
+        if (rng() % 3 != 0) {
+            tree.insert(entry);
+            reference.emplace(entry.start, entry.end, entry.id);
+        } else if (!reference.empty()) {
+            auto it = reference.lower_bound(Key(start, 0, 0));
+            if (it == reference.end()) it = reference.begin();
+            CalendarEntry present(get<0>(*it), get<1>(*it), get<2>(*it));
+            CHECK(tree.remove(present));
+            CHECK(!tree.remove(present));
+            reference.erase(it);
+        }
+        if (step % 50 == 0) {
+            versions.emplace_back(tree, reference);
+            CHECK(versions.back().first.sameVersion(tree));
+        }
+    }
+    CHECK(matches(tree, reference));
+    for (const auto& version : versions) {
+        CHECK(matches(version.first, version.second));
+        CHECK(!version.first.sameVersion(tree) || version.second == reference);
+    }
+}
+
+static void checkSharing() {
+    vector<CalendarEntry> sorted;
+    for (int i = 0; i < 4096; ++i) {
+        sorted.emplace_back(i * 10, i * 10 + 5, i + 1);
+    }
+    PersistentAVLTree base = PersistentAVLTree::fromSorted(sorted);
+    CHECK(base.size() == 4096);
+    // Height is at most 1.44 log2 n, about 18 here; a change copies the
+    // path plus the few nodes a rotation moves
+    const size_t bound = 3 * 18;
+    for (int i = 0; i < 200; ++i) {
+        PersistentAVLTree copy = base;
+        CHECK(copy.sameVersion(base) && unshared(copy, base) == 0);
+        copy.insert(CalendarEntry(i * 193 % 40960 + 7, i * 193 % 40960 + 8, 5000 + i));
+        CHECK(!copy.sameVersion(base));
+        CHECK(unshared(copy, base) <= bound);
+        copy.remove(sorted[i * 17 % sorted.size()]);
+        CHECK(unshared(copy, base) <= 2 * bound);
+        CHECK(base.size() == 4096 && copy.size() == 4096);
+    }
+}
+
+static void checkRelease(mt19937& rng) {
+    long before = liveAllocations;
+    {
+        vector<CalendarEntry> sorted;
+        for (int i = 0; i < 1000; ++i) {
+            sorted.emplace_back(i * 10, i * 10 + 5, i + 1);
+        }
+        PersistentAVLTree base = PersistentAVLTree::fromSorted(sorted);
+        long baseOnly = liveAllocations;
+        {
+            vector<PersistentAVLTree> versions;
+            PersistentAVLTree tree = base;
+            for (int i = 0; i < 500; ++i) {
+                tree.remove(sorted[rng() % sorted.size()]);
+                int start = (int)(rng() % 20000);
+                tree.insert(CalendarEntry(start, start + 3, 2000 + i));
+                if (i % 10 == 0) versions.push_back(tree);
+            }
+            CHECK(liveAllocations > baseOnly);
+        }
+        // Everything the later versions copied is gone; base is intact
+        CHECK(liveAllocations == baseOnly);
+        CHECK(base.size() == 1000);
+        PersistentAVLTree moved = move(base);
+        CHECK(base.empty() && moved.size() == 1000);
+    }
+    CHECK(liveAllocations == before);
+}
+
+int main() {
+    mt19937 rng(5);
+    for (int round = 0; round < 5; ++round) {
+        checkVersions(rng);
+    }
+    checkSharing();
+    checkRelease(rng);
+    return checkResult("persistent_test");
+}
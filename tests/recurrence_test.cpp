@@ -0,0 +1,203 @@
+// Repeating events: conflict checks, expanded occurrences and free slots
+// on an AVLTree mixing one-off events and series, and conflict checks on
+// the persistent calendar snapshots query, against brute force over every
+// occurrence up to a horizon.
+
+#include <algorithm>
+#include <climits>
+#include <map>
+#include <random>
+#include <set>
+#include <stdexcept>
+#include <tuple>
+#include <vector>
+#include "../AVLTree.h"
+#include "../PersistentAVLTree.h"
+#include "Check.h"
+
+using namespace std;
+
+using Span = pair<long long, long long>;
+
+// Past every series' last occurrence that a query below can reach
+static const long long HORIZON = 400LL * 1440;
+
+static vector<Span> occurrences(const Event& event) {
+    vector<Span> spans;
+    long long period = event.recurrence.period();
+    long long count = event.occurrences();
+    for (long long k = 0; k < count; ++k) {
+        long long start = event.start + k * period;
+        if (start > HORIZON) break;
+        spans.emplace_back(start, event.end + k * period);
+        if (!event.repeats()) break;
+    }
+    return spans;
+}
+
+static bool overlap(const Span& a, const Span& b) {
+    return a.first < b.second && b.first < a.second;
+}
+
+static bool bruteOverlap(const Event& a, const Event& b) {
+    for (const Span& x : occurrences(a)) {
+        for (const Span& y : occurrences(b)) {
+            if (overlap(x, y)) return true;
+        }
+    }
+    return false;
+}
+
+static Event randomEvent(mt19937& rng, int id, bool series) {
+    int day = (int)(rng() % 40);
+    int start = day * 1440 + (int)(rng() % 1440);
+    Event event(id, "e" + to_string(id), start, start);
+    if (series) {
+        static const int every[] = {1, 2, 3, 7};
+        event.recurrence.every = every[rng() % 4];
+        event.end = event.start + 1 + (int)(rng() % min(600, event.recurrence.period()));
+        if (rng() % 2) event.recurrence.until = day + (int)(rng() % 60);
+    } else {
+        // Now and then a long one-off event spanning several days
+        event.end = event.start + (rng() % 10 == 0 ? (int)(rng() % 5000) : 1 + (int)(rng() % 180));
+    }
+    return event;
+}
+
+int main() {
+    mt19937 rng(3);
+    for (int round = 0; round < 200; ++round) {
+        AVLTree tree;
+        map<int, Event> reference;
+        int n = (int)(rng() % 60), nextId = 1;
+        for (int i = 0; i < n; ++i) {
+            Event event = randomEvent(rng, nextId++, rng() % 4 == 0);
+            tree.insert(event);
+            reference[event.id] = event;
+        }
+        for (int i = 0; i < n / 6; ++i) {
+            int id = 1 + (int)(rng() % (nextId - 1));
+            tree.remove(id);
+            reference.erase(id);
+        }
+        // Turning a one-off event into a series, or back
+        if (rng() % 3 == 0 && !reference.empty()) {
+            auto it = reference.begin();
+            advance(it, rng() % reference.size());
+            Event changed = it->second;
+            changed.recurrence.every = changed.repeats() ? 0 : 1;
+            if (changed.repeats()) changed.end = changed.start + 1 + (int)(rng() % 600);
+            tree.insert(changed);
+            it->second = changed;
+        }
+
+        vector<CalendarEntry> sorted;
+        for (auto it = tree.begin(); it != tree.end(); ++it) {
+            sorted.push_back(*it);
+        }
+        PersistentAVLTree calendar = PersistentAVLTree::fromSorted(sorted);
+
+        vector<Span> busy;
+        for (const auto& entry : reference) {
+            vector<Span> spans = occurrences(entry.second);
+            busy.insert(busy.end(), spans.begin(), spans.end());
+        }
+
+        for (int q = 0; q < 40; ++q) {
+            Event probe = randomEvent(rng, -1, rng() % 3 == 0);
+            set<int> wanted;
+            for (const auto& entry : reference) {
+                bool clash = bruteOverlap(entry.second, probe);
+                CHECK(entry.second.overlaps(probe) == clash);
+                if (clash) wanted.insert(entry.first);
+            }
+            CHECK(tree.detectConflicts(probe) == !wanted.empty());
+            vector<Event> found = tree.findConflicts(probe);
+            set<int> foundIds;
+            for (const Event& event : found) {
+                foundIds.insert(event.id);
+                CHECK(event.name == reference[event.id].name);
+            }
+            CHECK(foundIds == wanted);
+            CHECK(calendar.detectConflicts(probe) == !wanted.empty());
+            vector<CalendarEntry> filed = calendar.findConflicts(probe);
+            set<int> filedIds;
+            for (const CalendarEntry& entry : filed) {
+                filedIds.insert(entry.id);
+            }
+            CHECK(filedIds == wanted && filedIds.size() == filed.size());
+            if (probe.repeats()) {
+                // One entry per clashing event
+                CHECK(foundIds.size() == found.size());
+            } else {
+                // One entry per clashing occurrence, in time order
+                vector<tuple<int, int, int>> clashes, reported;
+                for (const auto& entry : reference) {
+                    for (const Span& span : occurrences(entry.second)) {
+                        if (overlap(span, Span(probe.start, probe.end))) {
+                            clashes.emplace_back((int)span.first, (int)span.second, entry.first);
+                        }
+                    }
+                }
+                sort(clashes.begin(), clashes.end());
+                for (const Event& event : found) {
+                    reported.emplace_back(event.start, event.end, event.id);
+                }
+                CHECK(reported == clashes);
+            }
+
+            // Occurrences after the first, expanded for a window only
+            int from = (int)(rng() % (80 * 1440)), to = from + (int)(rng() % (20 * 1440));
+            vector<tuple<int, int, int>> expected;
+            for (const auto& entry : reference) {
+                if (!entry.second.repeats()) continue;
+                vector<Span> spans = occurrences(entry.second);
+                for (size_t k = 1; k < spans.size(); ++k) {
+                    if (spans[k].first >= from && spans[k].first < to) {
+                        expected.emplace_back((int)spans[k].first, (int)spans[k].second, entry.first);
+                    }
+                }
+            }
+            sort(expected.begin(), expected.end());
+            vector<tuple<int, int, int>> expanded;
+            for (const Event& event : tree.repeatsBetween(from, to)) {
+                expanded.emplace_back(event.start, event.end, event.id);
+            }
+            CHECK(expanded == expected);
+
+            // The earliest start clear of every occurrence
+            int slotFrom = (int)(rng() % (70 * 1440));
+            int duration = 1 + (int)(rng() % (rng() % 4 == 0 ? 1600 : 200));
+            vector<long long> candidates{slotFrom};
+            for (const Span& span : busy) {
+                if (span.second >= slotFrom) candidates.push_back(span.second);
+            }
+            sort(candidates.begin(), candidates.end());
+            long long want = -1;
+            for (long long start : candidates) {
+                if (start + duration > HORIZON - 200 * 1440) break;
+                Span wanted(start, start + duration);
+                if (none_of(busy.begin(), busy.end(), [&](const Span& span) { return overlap(span, wanted); })) {
+                    want = start;
+                    break;
+                }
+            }
+            try {
+                int slot = tree.findFreeSlot(slotFrom, duration);
+                CHECK(slot == want);
+                CHECK(!tree.detectConflicts(Event(-1, "", slot, slot + duration)));
+            } catch (const runtime_error&) {
+                // No slot before the search gives up
+                CHECK(want == -1);
+            }
+        }
+    }
+
+    Recurrence rule;
+    CHECK(Recurrence::parse("R:7:2024-12-31", rule) && rule.every == 7 && rule.field() == "R:7:2024-12-31");
+    CHECK(Recurrence::parse("R:1", rule) && rule.every == 1 && rule.until == INT_MAX && rule.field() == "R:1");
+    CHECK(!Recurrence::parse("R:", rule));
+    CHECK(!Recurrence::parse("R:x", rule));
+    CHECK(!Recurrence::parse("R:1:2024-13-01", rule));
+    return checkResult("recurrence_test");
+}
@@ -0,0 +1,173 @@
+// Scheduler transactions: after random creates, updates, deletes and
+// dependencies between begin() and rollback(), the events, dependencies,
+// timings, tree, persistent calendar and journal must be exactly as at
+// begin(), in memory and after reopening from disk.
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <unistd.h>
+#include "../Scheduler.h"
+#include "Check.h"
+
+using namespace std;
+
+static string readFile(const string& path) {
+    ifstream in(path, ios::binary);
+    return string((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+}
+
+// Everything a rollback must restore, as text
+static string dump(const Scheduler& scheduler) {
+    string text;
+    const AVLTree& tree = scheduler.getTree();
+    try {
+        tree.verify();
+    } catch (const runtime_error& e) {
+        text += string("broken: ") + e.what() + "\n";
+    }
+    for (const Event& event : tree) {
+        text += to_string(event.id) + "," + event.name + "," + to_string(event.start) + "," + to_string(event.end) +
+                "," + event.recurrence.field();
+        vector<pair<int, int>> edges = scheduler.getGraph().dependenciesOf(event.id);
+        sort(edges.begin(), edges.end());
+        for (const auto& edge : edges) {
+            text += ";" + to_string(edge.first) + ">" + to_string(edge.second);
+        }
+        EventTiming timing = scheduler.timing(event.id);
+        text += "," + to_string(timing.earliestStart) + "," + to_string(timing.latestStart) + "\n";
+    }
+    for (const CalendarEntry& entry : scheduler.calendarVersion()) {
+        text += "c" + to_string(entry.id) + "," + to_string(entry.start) + "," + to_string(entry.end) + "," +
+                entry.recurrence.field() + "\n";
+    }
+    vector<pair<int, int>> violations = scheduler.violatedDependencies();
+    sort(violations.begin(), violations.end());
+    for (const auto& violation : violations) {
+        text += "v" + to_string(violation.first) + ">" + to_string(violation.second) + "\n";
+    }
+    return text;
+}
+
+static string randomDate(mt19937& rng) {
+    return "2024-05-" + string(1, '1' + (char)(rng() % 3)) + string(1, '0' + (char)(rng() % 10));
+}
+
+static string randomTime(mt19937& rng, int fromHour) {
+    int hour = fromHour + (int)(rng() % (24 - fromHour));
+    return (hour < 10 ? "0" : "") + to_string(hour) + ":" + (rng() % 2 ? "00" : "30");
+}
+
+// One random change; most are refused now and then (conflicts, cycles,
+// unknown ids), which must leave nothing to undo
+static void randomChange(Scheduler& scheduler, mt19937& rng, int maxId) {
+    int id = 1 + (int)(rng() % maxId);
+    try {
+        switch (rng() % 5) {
+        case 0:
+        case 1: {
+            Recurrence rule;
+            if (rng() % 4 == 0) rule.every = 7;
+            int hour = (int)(rng() % 23);
+            scheduler.createEvent("n" + to_string(rng() % 5), randomDate(rng), Event::formatTime(hour * 60),
+                                  Event::formatTime(hour * 60 + 60 + (int)(rng() % 2) * 30), rule);
+            break;
+        }
+        case 2: {
+            optional<Recurrence> rule;
+            if (rng() % 4 == 0) rule = Recurrence{(int)(rng() % 2) * 7, INT_MAX};
+            scheduler.updateEvent(id, rng() % 2 ? "renamed" : "", rng() % 2 ? randomDate(rng) : "",
+                                  rng() % 2 ? randomTime(rng, 12) : "", "", rule);
+            break;
+        }
+        case 3:
+            scheduler.deleteEvent(id);
+            break;
+        default:
+            scheduler.addDependency(id, 1 + (int)(rng() % maxId));
+            break;
+        }
+    } catch (const runtime_error&) {
+    }
+}
+
+int main() {
+    char dirTemplate[] = "/tmp/rollback_test.XXXXXX";
+    const char* dir = mkdtemp(dirTemplate);
+    if (dir == nullptr) {
+        perror("mkdtemp");
+        return 1;
+    }
+    string events = string(dir) + "/events.txt";
+    string journal = events + ".journal";
+    mt19937 rng(9);
+
+    Scheduler scheduler(events);
+    scheduler.open();
+    for (int round = 0; round < 300; ++round) {
+        int maxId = 1;
+        for (const Event& event : scheduler.getTree()) {
+            maxId = max(maxId, event.id + 1);
+        }
+        string before = dump(scheduler);
+        string journaled = readFile(journal);
+
+        scheduler.begin();
+        int steps = 1 + (int)(rng() % 12);
+        for (int i = 0; i < steps; ++i) {
+            randomChange(scheduler, rng, maxId + 3);
+        }
+        if (rng() % 3 == 0) {
+            scheduler.rollback();
+            CHECK(!scheduler.pending());
+            CHECK(dump(scheduler) == before);
+            CHECK(readFile(journal) == journaled);
+        } else {
+            scheduler.commit();
+        }
+        scheduler.sync();
+
+        // Reopening from disk gives the same state
+        if (round % 25 == 0) {
+            string now = dump(scheduler);
+            Scheduler reopened(events);
+            reopened.open();
+            CHECK(dump(reopened) == now);
+        }
+    }
+
+    // Ids handed out by undone creates are handed out again
+    int next = scheduler.createEvent("a", "2023-06-01", "08:00", "09:00");
+    scheduler.begin();
+    CHECK(scheduler.createEvent("b", "2023-06-01", "10:00", "11:00") == next + 1);
+    CHECK(scheduler.pending());
+    scheduler.rollback();
+    CHECK(scheduler.createEvent("c", "2023-06-01", "10:00", "11:00") == next + 1);
+
+    // A compaction inside a transaction keeps what it folded in: only the
+    // changes after it are undone
+    scheduler.begin();
+    scheduler.createEvent("d", "2023-06-02", "10:00", "11:00");
+    scheduler.compact();
+    CHECK(!scheduler.pending());
+    string compacted = dump(scheduler);
+    scheduler.updateEvent(next, "e", "", "07:00", "");
+    scheduler.rollback();
+    CHECK(dump(scheduler) == compacted);
+    scheduler.sync();
+    {
+        Scheduler reopened(events);
+        reopened.open();
+        CHECK(dump(reopened) == compacted);
+    }
+    scheduler.close();
+
+    unlink(journal.c_str());
+    unlink(events.c_str());
+    rmdir(dir);
+    return checkResult("rollback_test");
+}
@@ -0,0 +1,190 @@
+// Server: pipelined requests over the socket are answered in order, and a
+// pass whose group-commit fsync fails answers its changes with errors and
+// leaves no trace of them, in memory or in the journal.
+
+#include <atomic>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <thread>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "../Server.h"
+#include "Check.h"
+
+using namespace std;
+
+// Replaces libc's fsync for the code compiled into this test: while set,
+// syncing the journal fails as a full or failing disk would make it
+static atomic<bool> failSync{false};
+
+extern "C" int fsync(int fd) {
+    char path[64], target[4096];
+    snprintf(path, sizeof(path), "/proc/self/fd/%d", fd);
+    ssize_t length = readlink(path, target, sizeof(target) - 1);
+    string file(target, length > 0 ? length : 0);
+    if (failSync && file.size() > 8 && file.compare(file.size() - 8, 8, ".journal") == 0) {
+        errno = EIO;
+        return -1;
+    }
+    return (int)syscall(SYS_fsync, fd);
+}
+
+static string readFile(const string& path) {
+    ifstream in(path, ios::binary);
+    return string((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+}
+
+static int connectTo(const string& path) {
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+    if (connect(fd, (sockaddr*)&addr, sizeof(addr)) == -1) {
+        perror("connect");
+        exit(1);
+    }
+    return fd;
+}
+
+// Sends all of requests in one write and reads until results answers
+// (lines starting ok, or error,) have come back
+static string exchange(int fd, const string& requests, int results) {
+    CHECK(::write(fd, requests.data(), requests.size()) == (ssize_t)requests.size());
+    string answers;
+    char buffer[4096];
+    auto finished = [&] {
+        int seen = 0;
+        size_t at = 0;
+        while (at < answers.size()) {
+            size_t eol = answers.find('\n', at);
+            if (eol == string::npos) break;
+            seen += answers.compare(at, 3, "ok,") == 0 || answers.compare(at, 6, "error,") == 0;
+            at = eol + 1;
+        }
+        return seen >= results;
+    };
+    while (!finished()) {
+        ssize_t got = ::read(fd, buffer, sizeof(buffer));
+        if (got <= 0) break;
+        answers.append(buffer, got);
+    }
+    return answers;
+}
+
+int main() {
+    char dirTemplate[] = "/tmp/server_test.XXXXXX";
+    const char* dir = mkdtemp(dirTemplate);
+    if (dir == nullptr) {
+        perror("mkdtemp");
+        return 1;
+    }
+    string events = string(dir) + "/events.txt";
+    string journal = events + ".journal";
+    string socketPath = string(dir) + "/sock";
+
+    Scheduler scheduler(events);
+    scheduler.open();
+    Server server(scheduler, socketPath);
+    server.listen();
+    thread loop([&] { server.run(); });
+
+    // Pipelined: every line in one write, answered in order
+    int first = connectTo(socketPath);
+    string answers = exchange(first,
+                              "create,A,2024-05-06,10:00,11:00\n"
+                              "create,B,2024-05-06,10:30,11:30\n"
+                              "create,C,2024-05-06,12:00,13:00\n"
+                              "# comment\n"
+                              "depend,1,2\n"
+                              "find,2\n"
+                              "count,2024-05-06,2024-05-06\n",
+                              6);
+    CHECK(answers == "ok,create,1\n"
+                     "error,create,Event conflicts with existing events\n"
+                     "ok,create,2\n"
+                     "ok,depend,1,2\n"
+                     "event,2,C,2024-05-06,12:00,13:00\n"
+                     "ok,find\n"
+                     "ok,count,2\n");
+
+    // A request split across writes waits for its newline
+    CHECK(::write(first, "coun", 4) == 4);
+    usleep(20000);
+    answers = exchange(first, "t,2024-05-06,2024-05-06\n", 1);
+    CHECK(answers == "ok,count,2\n");
+
+    // A failed sync: changes become errors, queries in the same pass are
+    // answered as run, and the changes are gone afterwards
+    string journaled = readFile(journal);
+    failSync = true;
+    answers = exchange(first,
+                       "create,D,2024-05-07,09:00,10:00\n"
+                       "update,1,Renamed,,,\n"
+                       "find,1\n"
+                       "delete,2\n",
+                       4);
+    failSync = false;
+    CHECK(answers == "error,create,Cannot sync journal " + journal + ": Input/output error\n"
+                     "error,update,Cannot sync journal " + journal + ": Input/output error\n"
+                     "event,1,Renamed,2024-05-06,10:00,11:00\n"
+                     "ok,find\n"
+                     "error,delete,Cannot sync journal " + journal + ": Input/output error\n");
+    CHECK(readFile(journal) == journaled);
+
+    // Another connection sees the calendar as before the failed pass, and
+    // the next id is handed out again
+    int second = connectTo(socketPath);
+    answers = exchange(second,
+                       "find,1\n"
+                       "find,2\n"
+                       "toposort\n"
+                       "create,E,2024-05-07,09:00,10:00\n",
+                       4);
+    CHECK(answers == "event,1,A,2024-05-06,10:00,11:00\n"
+                     "ok,find\n"
+                     "event,2,C,2024-05-06,12:00,13:00\n"
+                     "ok,find\n"
+                     "event,1,A,2024-05-06,10:00,11:00\n"
+                     "event,2,C,2024-05-06,12:00,13:00\n"
+                     "ok,toposort,2\n"
+                     "ok,create,3\n");
+
+    // A save in the pass makes the changes before it durable; only the
+    // ones after it are retracted
+    failSync = true;
+    answers = exchange(second,
+                       "update,3,Saved,,,\n"
+                       "save\n"
+                       "update,3,Lost,,,\n",
+                       3);
+    failSync = false;
+    CHECK(answers == "ok,update,3\n"
+                     "ok,save\n"
+                     "error,update,Cannot sync journal " + journal + ": Input/output error\n");
+    answers = exchange(second, "find,3\n", 1);
+    CHECK(answers == "event,3,Saved,2024-05-07,09:00,10:00\nok,find\n");
+
+    close(first);
+    close(second);
+    server.stop();
+    loop.join();
+
+    // The journal replays to what the clients were told
+    scheduler.close();
+    {
+        Scheduler reopened(events);
+        reopened.open();
+        CHECK(reopened.findEvent(1).name == "A");
+        CHECK(reopened.findEvent(3).name == "Saved");
+        CHECK(reopened.getGraph().hasDependency(1, 2));
+    }
+
+    unlink(journal.c_str());
+    unlink(events.c_str());
+    rmdir(dir);
+    return checkResult("server_test");
+}
@@ -0,0 +1,147 @@
+// Join-based set operations on AVLTree: union, difference, split and join,
+// serial and on a thread pool, checked against maps of events and with
+// verify() on every result.
+
+#include <algorithm>
+#include <map>
+#include <random>
+#include <stdexcept>
+#include <vector>
+#include "../AVLTree.h"
+#include "../ThreadPool.h"
+#include "Check.h"
+
+using namespace std;
+
+static void checkTree(const AVLTree& tree, const map<int, Event>& reference) {
+    try {
+        tree.verify();
+    } catch (const runtime_error& e) {
+        fprintf(stderr, "%s\n", e.what());
+        CHECK(false);
+    }
+    vector<Event> sorted;
+    for (const auto& entry : reference) {
+        sorted.push_back(entry.second);
+    }
+    sort(sorted.begin(), sorted.end());
+    CHECK(tree.size() == sorted.size());
+    size_t i = 0;
+    for (auto it = tree.begin(); it != tree.end(); ++it, ++i) {
+        Event event = *it;
+        CHECK(i < sorted.size() && event.id == sorted[i].id && event.start == sorted[i].start &&
+              event.end == sorted[i].end && event.name == sorted[i].name);
+    }
+    CHECK(i == sorted.size());
+}
+
+static Event randomEvent(mt19937& rng, int id, int span) {
+    int start = (int)(rng() % span);
+    return Event(id, "e" + to_string(id) + "_" + to_string(rng() % 3), start, start + 1 + (int)(rng() % 60));
+}
+
+int main() {
+    mt19937 rng(11);
+    ThreadPool pool(4);
+    for (int round = 0; round < 200; ++round) {
+        ThreadPool* workers = round % 2 ? &pool : nullptr;
+        // A few large rounds so the parallel split kicks in
+        int limit = round < 190 ? 300 : 20000;
+        int n1 = (int)(rng() % limit), n2 = (int)(rng() % limit);
+        int ids = (n1 + n2) * (1 + (int)(rng() % 3)) + 1;
+        int span = 1 + (int)(rng() % 100000);
+
+        AVLTree a, b;
+        map<int, Event> refA, refB;
+        for (int i = 0; i < n1; ++i) {
+            Event event = randomEvent(rng, 1 + (int)(rng() % ids), span);
+            a.insert(event);
+            refA[event.id] = event;
+        }
+        for (int i = 0; i < n2; ++i) {
+            Event event = randomEvent(rng, 1 + (int)(rng() % ids), span);
+            // Some events shared with a, some of those renamed
+            if (rng() % 3 == 0) {
+                auto shared = refA.lower_bound(1 + (int)(rng() % ids));
+                if (shared != refA.end()) event = shared->second;
+                if (rng() % 4 == 0) event.name = "renamed";
+            }
+            b.insert(event);
+            refB[event.id] = event;
+        }
+        checkTree(a, refA);
+        checkTree(b, refB);
+
+        switch (rng() % 4) {
+        case 0:
+            // b wins on shared ids
+            a.unionWith(b, workers);
+            for (const auto& entry : refB) {
+                refA[entry.first] = entry.second;
+            }
+            checkTree(a, refA);
+            checkTree(b, refB);
+            break;
+        case 1:
+            // Only events at the same times leave
+            a.differenceWith(b, workers);
+            for (const auto& entry : refB) {
+                auto it = refA.find(entry.first);
+                if (it != refA.end() && it->second.start == entry.second.start && it->second.end == entry.second.end) {
+                    refA.erase(it);
+                }
+            }
+            checkTree(a, refA);
+            checkTree(b, refB);
+            break;
+        case 2: {
+            int time = (int)(rng() % span);
+            AVLTree later;
+            a.splitAt(time, later);
+            map<int, Event> refLater;
+            for (auto it = refA.begin(); it != refA.end();) {
+                if (it->second.start >= time) {
+                    refLater.insert(*it);
+                    it = refA.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+            checkTree(a, refA);
+            checkTree(later, refLater);
+            // later comes after a, so joining them the other way round is refused
+            bool refused = false;
+            try {
+                later.join(a);
+            } catch (const runtime_error&) {
+                refused = true;
+            }
+            CHECK(refused == (!refA.empty() && !refLater.empty()));
+            break;
+        }
+        default: {
+            AVLTree early, late;
+            map<int, Event> refEarly, refLate;
+            int cut = span / 2, id = 1;
+            for (int i = 0; i < n1; ++i) {
+                Event event = randomEvent(rng, id++, max(1, cut - 100));
+                early.insert(event);
+                refEarly[event.id] = event;
+            }
+            for (int i = 0; i < n2; ++i) {
+                Event event = randomEvent(rng, id++, max(1, cut - 100));
+                event.start += cut;
+                event.end += cut;
+                late.insert(event);
+                refLate[event.id] = event;
+            }
+            early.join(late);
+            refEarly.insert(refLate.begin(), refLate.end());
+            checkTree(early, refEarly);
+            checkTree(late, {});
+            break;
+        }
+        }
+    }
+    return checkResult("setops_test");
+}
@@ -0,0 +1,249 @@
+// Snapshots: EpochPtr frees a replaced object only once no reader can
+// still see it, and six reader threads querying pinned snapshots while
+// the scheduler changes and publishes always find exactly the calendar
+// of the version they pinned, checked against brute force. Worth running
+// under -fsanitize=thread as well.
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+#include "../Scheduler.h"
+#include "Check.h"
+
+using namespace std;
+
+// Counts instances alive, to see what EpochPtr has freed
+struct Tracked {
+    static atomic<int> alive;
+    int value;
+
+    explicit Tracked(int value) : value(value) {
+        ++alive;
+    }
+
+    ~Tracked() {
+        --alive;
+    }
+};
+
+atomic<int> Tracked::alive{0};
+
+static void checkReclaim() {
+    {
+        EpochPtr<Tracked> pointer(2);
+        pointer.publish(make_unique<Tracked>(1));
+        auto first = pointer.reader();
+        auto second = pointer.reader();
+        bool refused = false;
+        try {
+            pointer.reader();
+        } catch (const runtime_error&) {
+            refused = true;
+        }
+        CHECK(refused);
+
+        {
+            auto guard = first.pin();
+            CHECK(guard->value == 1);
+            pointer.publish(make_unique<Tracked>(2));
+            pointer.publish(make_unique<Tracked>(3));
+            // Both replaced objects wait for the reader that entered
+            // before them
+            CHECK(guard->value == 1);
+            CHECK(Tracked::alive == 3 && pointer.retiredCount() == 2);
+            auto later = second.pin();
+            CHECK(later->value == 3);
+        }
+        pointer.reclaim();
+        CHECK(Tracked::alive == 1 && pointer.retiredCount() == 0);
+
+        // A released slot can be claimed again
+        {
+            auto moved = move(second);
+        }
+        auto third = pointer.reader();
+        CHECK(third.pin()->value == 3);
+    }
+    CHECK(Tracked::alive == 0);
+}
+
+static string dayOf(mt19937& rng) {
+    return "2024-06-" + string(1, '1' + (char)(rng() % 2)) + string(1, '0' + (char)(rng() % 10));
+}
+
+// One random change through the scheduler; true if it was made
+static bool randomChange(Scheduler& scheduler, mt19937& rng, int maxId) {
+    int id = 1 + (int)(rng() % maxId);
+    try {
+        switch (rng() % 4) {
+        case 0:
+        case 1: {
+            Recurrence rule;
+            if (rng() % 5 == 0) rule.every = 1 + (int)(rng() % 7);
+            int start = (int)(rng() % (23 * 60));
+            scheduler.createEvent("e", dayOf(rng), Event::formatTime(start),
+                                  Event::formatTime(start + 1 + (int)(rng() % 59)), rule);
+            return true;
+        }
+        case 2: {
+            int start = (int)(rng() % (23 * 60));
+            scheduler.updateEvent(id, "", rng() % 2 ? dayOf(rng) : "", Event::formatTime(start),
+                                  Event::formatTime(start + 1 + (int)(rng() % 59)));
+            return true;
+        }
+        default:
+            scheduler.deleteEvent(id);
+            return true;
+        }
+    } catch (const runtime_error&) {
+        return false;
+    }
+}
+
+// What one reader found wrong, checked on the main thread afterwards
+struct ReaderResult {
+    size_t snapshots = 0;
+    size_t wrong = 0;
+    size_t backwards = 0;
+};
+
+int main() {
+    checkReclaim();
+
+    char dirTemplate[] = "/tmp/snapshot_test.XXXXXX";
+    const char* dir = mkdtemp(dirTemplate);
+    if (dir == nullptr) {
+        perror("mkdtemp");
+        return 1;
+    }
+    string events = string(dir) + "/events.txt";
+    string journal = events + ".journal";
+
+    const int changes = 3000;
+    Scheduler scheduler(events);
+    scheduler.open();
+
+    // The calendar of each published version, from the AVLTree, written
+    // before the version is published and never changed afterwards
+    vector<vector<CalendarEntry>> expected(changes + 1);
+    atomic<bool> done{false};
+
+    const int readers = 6;
+    vector<ReaderResult> results(readers);
+    vector<thread> threads;
+    for (int r = 0; r < readers; ++r) {
+        threads.emplace_back([&, r] {
+            mt19937 rng(100 + r);
+            ReaderResult& result = results[r];
+            Scheduler::SnapshotReader reader = scheduler.snapshotReader();
+            uint64_t last = 0;
+            while (!done) {
+                auto snapshot = reader.pin();
+                const vector<CalendarEntry>& want = expected[snapshot->version()];
+                ++result.snapshots;
+                result.backwards += snapshot->version() < last;
+                last = snapshot->version();
+
+                bool same = snapshot->size() == want.size();
+                auto it = want.begin();
+                for (const CalendarEntry& entry : snapshot->calendar()) {
+                    if (!same || it == want.end()) {
+                        same = false;
+                        break;
+                    }
+                    same = entry.start == it->start && entry.end == it->end && entry.id == it->id &&
+                           entry.recurrence.field() == it->recurrence.field();
+                    ++it;
+                }
+
+                int base = Event::parseDate("2024-06-01") * 1440;
+                int from = base + (int)(rng() % (20 * 1440)), to = from + (int)(rng() % (3 * 1440));
+                vector<CalendarEntry> between;
+                for (const CalendarEntry& entry : want) {
+                    if (entry.start >= from && entry.start < to) between.push_back(entry);
+                }
+                vector<CalendarEntry> found = snapshot->entriesBetween(from, to);
+                same = same && found.size() == between.size();
+                for (size_t i = 0; same && i < found.size(); ++i) {
+                    same = found[i].id == between[i].id;
+                }
+
+                CalendarEntry probe(from, from + 1 + (int)(rng() % 120), -1);
+                vector<int> clashing;
+                for (const CalendarEntry& entry : want) {
+                    if (entry.times().overlaps(probe.times())) clashing.push_back(entry.id);
+                }
+                vector<int> reported;
+                for (const CalendarEntry& entry : snapshot->findConflicts(probe)) {
+                    reported.push_back(entry.id);
+                }
+                sort(clashing.begin(), clashing.end());
+                sort(reported.begin(), reported.end());
+                same = same && reported == clashing && snapshot->hasConflict(probe) == !clashing.empty();
+                result.wrong += !same;
+            }
+        });
+    }
+
+    // The writer: the only thread changing the scheduler. Versions count
+    // the changes made; a rollback takes the count back with them.
+    mt19937 rng(11);
+    uint64_t version = 0;
+    // A version seen before (nothing changed, or rolled back to) is already
+    // filled in, and readers may be looking at it
+    auto publish = [&] {
+        vector<CalendarEntry>& entries = expected[version];
+        if (entries.empty()) {
+            for (const Event& event : scheduler.getTree()) {
+                entries.emplace_back(event);
+            }
+        }
+        scheduler.publish();
+    };
+    int made = 0;
+    while (made < changes - 20) {
+        bool transaction = rng() % 8 == 0;
+        uint64_t savedVersion = version;
+        if (transaction) scheduler.begin();
+        int steps = 1 + (int)(rng() % 5);
+        for (int i = 0; i < steps && made < changes - 20; ++i) {
+            if (randomChange(scheduler, rng, made + 2)) {
+                ++version;
+                ++made;
+            }
+        }
+        if (transaction) {
+            if (rng() % 2) {
+                scheduler.rollback();
+                version = savedVersion;
+            } else {
+                scheduler.commit();
+            }
+        }
+        publish();
+        CHECK(scheduler.snapshotReader().pin()->version() == version);
+    }
+    done = true;
+    for (thread& t : threads) {
+        t.join();
+    }
+
+    for (const ReaderResult& result : results) {
+        CHECK(result.snapshots > 0);
+        CHECK(result.wrong == 0);
+        CHECK(result.backwards == 0);
+    }
+    scheduler.close();
+
+    unlink(journal.c_str());
+    unlink(events.c_str());
+    rmdir(dir);
+    return checkResult("snapshot_test");
+}
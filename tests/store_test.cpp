@@ -0,0 +1,157 @@
+// StringPool and EventStore: interned names, their reference counts, id
+// and slot reuse, and the arena compaction, against plain maps through
+// random adds, renames and removes.
+
+#include <algorithm>
+#include <map>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+#include "../EventStore.h"
+#include "../StringPool.h"
+#include "Check.h"
+
+using namespace std;
+
+// Short names collide often; now and then a long one fills the arena fast
+static string randomName(mt19937& rng) {
+    if (rng() % 10 == 0) {
+        return string(100 + rng() % 200, (char)('a' + rng() % 26)) + to_string(rng() % 50);
+    }
+    return "n" + to_string(rng() % 300);
+}
+
+static void checkPool(mt19937& rng) {
+    StringPool pool;
+    map<string, int> idOf;
+    map<int, int> refs; // Id -> references held
+    size_t peak = 0;
+    int highest = -1;
+    for (int step = 0; step < 50000; ++step) {
+        if (refs.empty() || rng() % 2 == 0) {
+            string s = randomName(rng);
+            int id = pool.intern(s);
+            auto known = idOf.find(s);
+            if (known != idOf.end()) {
+                CHECK(id == known->second);
+            } else {
+                CHECK(refs.count(id) == 0);
+                idOf[s] = id;
+            }
+            ++refs[id];
+            highest = max(highest, id);
+        } else {
+            auto it = refs.begin();
+            advance(it, rng() % refs.size());
+            int id = it->first;
+            pool.release(id);
+            if (--it->second == 0) {
+                refs.erase(it);
+                for (auto named = idOf.begin(); named != idOf.end(); ++named) {
+                    if (named->second == id) {
+                        idOf.erase(named);
+                        break;
+                    }
+                }
+            }
+        }
+        peak = max(peak, refs.size());
+        if (step % 500 == 0) {
+            CHECK(pool.size() == refs.size());
+            for (const auto& named : idOf) {
+                CHECK(pool.view(named.second) == named.first);
+            }
+        }
+    }
+    // Released ids are handed out again before new ones
+    CHECK((size_t)highest < peak);
+
+    // Releasing most of a full arena compacts it: the survivors move but
+    // keep their ids and text
+    StringPool arena;
+    vector<int> ids;
+    for (int i = 0; i < 100; ++i) {
+        ids.push_back(arena.intern(string(100, 'x') + to_string(i)));
+    }
+    const char* before = arena.view(ids[99]).data();
+    for (int i = 0; i < 60; ++i) {
+        arena.release(ids[i]);
+    }
+    CHECK(arena.view(ids[99]).data() != before);
+    CHECK(arena.size() == 40);
+    for (int i = 60; i < 100; ++i) {
+        CHECK(arena.view(ids[i]) == string(100, 'x') + to_string(i));
+    }
+    CHECK(arena.intern(string(100, 'x') + "99") == ids[99]);
+    CHECK(arena.intern(string(100, 'x') + "0") < 60);
+}
+
+static void checkStore(mt19937& rng) {
+    EventStore store;
+    map<int, Event> reference;
+    size_t peak = 0;
+    for (int step = 0; step < 20000; ++step) {
+        int id = 1 + (int)(rng() % 400);
+        int slot = store.slotOf(id);
+        CHECK((slot != -1) == (reference.count(id) != 0));
+        switch (rng() % 4) {
+        case 0:
+        case 1: {
+            int start = (int)(rng() % 100000);
+            Event event(id, randomName(rng), start, start + 1 + (int)(rng() % 300));
+            if (rng() % 6 == 0) event.recurrence.every = 1 + (int)(rng() % 7);
+            int added = store.add(event);
+            // An id already present keeps its slot
+            CHECK(slot == -1 || added == slot);
+            reference[id] = event;
+            break;
+        }
+        case 2:
+            if (slot != -1) {
+                // Sometimes another event's name, passed as a view into
+                // the pool itself
+                string name = randomName(rng);
+                int other = store.slotOf(1 + (int)(rng() % 400));
+                if (other != -1 && rng() % 2) {
+                    store.setName(slot, store.name(other));
+                    name = reference[store.id(other)].name;
+                } else {
+                    store.setName(slot, name);
+                }
+                reference[id].name = name;
+            }
+            break;
+        default:
+            store.remove(id);
+            reference.erase(id);
+            break;
+        }
+        peak = max(peak, reference.size());
+
+        if (step % 200 == 0) {
+            CHECK(store.size() == reference.size());
+            // Freed slots are reused before the columns grow
+            CHECK(store.slots() <= peak);
+            set<string> names;
+            for (const auto& entry : reference) {
+                const Event& want = entry.second;
+                int s = store.slotOf(entry.first);
+                CHECK(s != -1 && store.isLive(s));
+                Event got = store.event(s);
+                CHECK(got.id == want.id && got.name == want.name && got.start == want.start &&
+                      got.end == want.end && got.recurrence.every == want.recurrence.every);
+                CHECK(store.repeats(s) == want.repeats());
+                names.insert(want.name);
+            }
+            CHECK(store.distinctNames() == names.size());
+        }
+    }
+}
+
+int main() {
+    mt19937 rng(17);
+    checkPool(rng);
+    checkStore(rng);
+    return checkResult("store_test");
+}
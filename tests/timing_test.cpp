@@ -0,0 +1,183 @@
+// Incremental timing: after every edit the EventGraph's cached earliest
+// and latest starts, violations and critical path must match a full
+// recompute, both from a graph rebuilt from scratch and from a brute-force
+// pass over the reference events and edges.
+
+#include <algorithm>
+#include <map>
+#include <random>
+#include <set>
+#include <stdexcept>
+#include <vector>
+#include "../EventGraph.h"
+#include "Check.h"
+
+using namespace std;
+
+struct Reference {
+    map<int, Event> events;
+    set<pair<int, int>> edges; // (prerequisite, dependent)
+};
+
+static int duration(const Event& event) {
+    return event.end - event.start;
+}
+
+// Earliest start: the latest finish of any prerequisite, else the event's
+// own start. Latest finish: the earliest latest start of any dependent,
+// else the event's own end.
+static void bruteTimings(const Reference& ref, const vector<Event>& order, map<int, int>& earliest, map<int, int>& latestStart) {
+    for (const Event& event : order) {
+        bool any = false;
+        int start = event.start;
+        for (const auto& edge : ref.edges) {
+            if (edge.second != event.id) continue;
+            int finish = earliest[edge.first] + duration(ref.events.at(edge.first));
+            if (!any || finish > start) start = finish;
+            any = true;
+        }
+        earliest[event.id] = start;
+    }
+    map<int, int> latestFinish;
+    for (auto it = order.rbegin(); it != order.rend(); ++it) {
+        bool any = false;
+        int finish = it->end;
+        for (const auto& edge : ref.edges) {
+            if (edge.first != it->id) continue;
+            int start = latestFinish[edge.second] - duration(ref.events.at(edge.second));
+            if (!any || start < finish) finish = start;
+            any = true;
+        }
+        latestFinish[it->id] = finish;
+        latestStart[it->id] = finish - duration(*it);
+    }
+}
+
+static int pathLength(const EventGraph& graph, const vector<Event>& path) {
+    if (path.empty()) return 0;
+    return graph.timing(path.back().id).earliestStart + duration(path.back()) - path.front().start;
+}
+
+static void checkAgainstRecompute(EventGraph& graph, const Reference& ref) {
+    vector<Event> order = graph.topologicalSort();
+    CHECK(order.size() == ref.events.size());
+    map<int, size_t> position;
+    for (size_t i = 0; i < order.size(); ++i) {
+        position[order[i].id] = i;
+    }
+    for (const auto& edge : ref.edges) {
+        CHECK(position[edge.first] < position[edge.second]);
+    }
+
+    EventGraph fresh;
+    for (const auto& entry : ref.events) {
+        fresh.addEvent(entry.second);
+    }
+    for (const auto& edge : ref.edges) {
+        fresh.addDependency(edge.first, edge.second);
+    }
+
+    map<int, int> earliest, latestStart;
+    bruteTimings(ref, order, earliest, latestStart);
+    for (const auto& entry : ref.events) {
+        EventTiming incremental = graph.timing(entry.first);
+        EventTiming rebuilt = fresh.timing(entry.first);
+        CHECK(incremental.earliestStart == rebuilt.earliestStart && incremental.latestStart == rebuilt.latestStart);
+        CHECK(incremental.earliestStart == earliest[entry.first] && incremental.latestStart == latestStart[entry.first]);
+        CHECK(incremental.slack == incremental.latestStart - incremental.earliestStart);
+    }
+
+    set<pair<int, int>> violated;
+    for (const auto& edge : ref.edges) {
+        if (ref.events.at(edge.first).end > ref.events.at(edge.second).start) violated.insert(edge);
+    }
+    vector<pair<int, int>> reported = graph.violatedDependencies();
+    set<pair<int, int>> reportedSet(reported.begin(), reported.end());
+    CHECK(reportedSet == violated);
+
+    vector<Event> path = graph.criticalPath();
+    vector<Event> rebuiltPath = fresh.criticalPath();
+    CHECK(pathLength(graph, path) == pathLength(fresh, rebuiltPath));
+    for (size_t i = 1; i < path.size(); ++i) {
+        CHECK(ref.edges.count(make_pair(path[i - 1].id, path[i].id)) == 1);
+    }
+}
+
+static bool reaches(const Reference& ref, int from, int to) {
+    set<int> seen{from};
+    vector<int> stack{from};
+    while (!stack.empty()) {
+        int at = stack.back();
+        stack.pop_back();
+        if (at == to) return true;
+        for (const auto& edge : ref.edges) {
+            if (edge.first == at && seen.insert(edge.second).second) stack.push_back(edge.second);
+        }
+    }
+    return false;
+}
+
+int main() {
+    mt19937 rng(3);
+    // Minutes around 2023, so dates and times format back and forth
+    const int base = 19500 * 1440;
+    for (int round = 0; round < 150; ++round) {
+        EventGraph graph;
+        Reference ref;
+        int nextId = 1;
+        for (int step = 0; step < 60; ++step) {
+            int op = (int)(rng() % 6);
+            if (op <= 1 || ref.events.empty()) {
+                int start = base + (int)(rng() % 3000);
+                Event event(nextId++, "e", start, start + 1 + (int)(rng() % 200));
+                graph.addEvent(event);
+                ref.events[event.id] = event;
+                continue;
+            }
+            auto pick = ref.events.begin();
+            advance(pick, rng() % ref.events.size());
+            int id = pick->first;
+            if (op == 2) {
+                auto other = ref.events.begin();
+                advance(other, rng() % ref.events.size());
+                bool cycle = id == other->first || reaches(ref, other->first, id);
+                bool refused = false;
+                try {
+                    graph.addDependency(id, other->first);
+                } catch (const runtime_error&) {
+                    refused = true;
+                }
+                CHECK(refused == cycle);
+                if (!refused) ref.edges.insert({id, other->first});
+            } else if (op == 3) {
+                string time = Event::formatTime((int)(rng() % 1440));
+                switch (rng() % 3) {
+                case 0:
+                    graph.updateEventStartTime(id, time);
+                    break;
+                case 1:
+                    graph.updateEventEndTime(id, time);
+                    break;
+                default:
+                    graph.updateEventDate(id, Event::formatDate(19500 + (int)(rng() % 3)));
+                    break;
+                }
+                ref.events[id] = graph.findEventById(id);
+            } else if (op == 4) {
+                graph.deleteEvent(id);
+                ref.events.erase(id);
+                for (auto it = ref.edges.begin(); it != ref.edges.end();) {
+                    it = it->first == id || it->second == id ? ref.edges.erase(it) : next(it);
+                }
+            } else {
+                // Re-adding an id moves it
+                Event moved = pick->second;
+                moved.start -= (int)(rng() % 50);
+                graph.addEvent(moved);
+                ref.events[id] = moved;
+            }
+            checkAgainstRecompute(graph, ref);
+        }
+    }
+    return checkResult("timing_test");
+}
@@ -0,0 +1,130 @@
+// AVLTree against a plain map of events: random inserts, moves and
+// removes, with the cached fields checked by verify() and every query
+// compared with a brute-force answer over the map.
+
+#include <algorithm>
+#include <climits>
+#include <map>
+#include <random>
+#include <stdexcept>
+#include <vector>
+#include "../AVLTree.h"
+#include "Check.h"
+
+using namespace std;
+
+static bool overlap(const Event& a, const Event& b) {
+    return a.start < b.end && b.start < a.end;
+}
+
+static vector<Event> sortedEvents(const map<int, Event>& reference) {
+    vector<Event> sorted;
+    for (const auto& entry : reference) {
+        sorted.push_back(entry.second);
+    }
+    sort(sorted.begin(), sorted.end());
+    return sorted;
+}
+
+static bool verified(const AVLTree& tree) {
+    try {
+        tree.verify();
+        return true;
+    } catch (const runtime_error& e) {
+        fprintf(stderr, "%s\n", e.what());
+        return false;
+    }
+}
+
+// Earliest start at or after from with no event overlapping duration minutes
+static int bruteFreeSlot(const vector<Event>& sorted, int from, int duration) {
+    vector<int> candidates{from};
+    for (const Event& event : sorted) {
+        if (event.end >= from) candidates.push_back(event.end);
+    }
+    sort(candidates.begin(), candidates.end());
+    for (int start : candidates) {
+        Event wanted(-1, "", start, start + duration);
+        bool free = none_of(sorted.begin(), sorted.end(), [&](const Event& event) { return overlap(wanted, event); });
+        if (free) return start;
+    }
+    return INT_MIN;
+}
+
+static void checkQueries(const AVLTree& tree, const map<int, Event>& reference, mt19937& rng, int span) {
+    vector<Event> sorted = sortedEvents(reference);
+    CHECK(tree.size() == sorted.size());
+
+    size_t i = 0;
+    for (auto it = tree.begin(); it != tree.end(); ++it, ++i) {
+        Event event = *it;
+        CHECK(i < sorted.size() && event.id == sorted[i].id && event.start == sorted[i].start &&
+              event.end == sorted[i].end && event.name == sorted[i].name);
+    }
+    CHECK(i == sorted.size());
+    for (const auto& entry : reference) {
+        optional<Event> found = tree.find(entry.first);
+        CHECK(found && found->start == entry.second.start && found->end == entry.second.end);
+    }
+
+    int start = (int)(rng() % span);
+    Event probe(-1, "", start, start + (int)(rng() % 80));
+    size_t overlapping = count_if(sorted.begin(), sorted.end(), [&](const Event& event) { return overlap(probe, event); });
+    CHECK(tree.findConflicts(probe).size() == overlapping);
+    CHECK(tree.detectConflicts(probe) == (overlapping > 0));
+
+    size_t before = count_if(sorted.begin(), sorted.end(), [&](const Event& event) { return event < probe; });
+    CHECK(tree.rank(probe) == before);
+    if (!sorted.empty()) {
+        size_t k = rng() % sorted.size();
+        CHECK((*tree.select(k)).id == sorted[k].id);
+    }
+    CHECK(tree.select(sorted.size()) == tree.end());
+
+    int from = (int)(rng() % span), to = from + (int)(rng() % span);
+    size_t inRange = count_if(sorted.begin(), sorted.end(), [&](const Event& event) { return event.start >= from && event.start < to; });
+    CHECK(tree.countInRange(from, to) == inRange);
+    size_t ranged = 0;
+    for (const Event& event : tree.range(from, to)) {
+        ranged += event.start >= from && event.start < to;
+    }
+    CHECK(ranged == inRange);
+
+    int slotFrom = (int)(rng() % span) - 50, duration = 1 + (int)(rng() % 100);
+    CHECK(tree.findFreeSlot(slotFrom, duration) == bruteFreeSlot(sorted, slotFrom, duration));
+}
+
+int main() {
+    mt19937 rng(1);
+    for (int round = 0; round < 200; ++round) {
+        AVLTree tree;
+        map<int, Event> reference;
+        int ids = 1 + (int)(rng() % 200);
+        int span = 1 + (int)(rng() % 3000);
+        for (int step = 0; step < ids * 3; ++step) {
+            int id = 1 + (int)(rng() % ids);
+            int op = (int)(rng() % 10);
+            if (op < 6) {
+                // An id already present moves to its new times
+                int start = (int)(rng() % span);
+                Event event(id, "e" + to_string(id), start, start + (int)(rng() % 60));
+                tree.insert(event);
+                reference[id] = event;
+            } else {
+                tree.remove(id);
+                reference.erase(id);
+            }
+            if (step % 7 == 0) {
+                CHECK(verified(tree));
+                checkQueries(tree, reference, rng, span);
+            }
+        }
+        CHECK(verified(tree));
+
+        AVLTree rebuilt;
+        rebuilt.buildFromSorted(sortedEvents(reference));
+        CHECK(verified(rebuilt));
+        checkQueries(rebuilt, reference, rng, span);
+    }
+    return checkResult("tree_test");
+}